@@ -1,1084 +1,5640 @@
 #include "raylib.h"
 #include "raymath.h"
+#include "rlgl.h"
+
+#include <stdio.h>          // Required for: printf()
+#include <stdlib.h>         // Required for: atoi(), strtoul()
+#include <string.h>         // Required for: memcpy(), strcmp()
+#include <time.h>           // Required for: clock(), clock_gettime()
+
+#if !defined(_WIN32)
+    #include <sys/resource.h>   // Required for: getrusage()
+#endif
+
+// Chunk meshes are built on a worker thread and enemy AI runs on a thread pool where threads are available
+#if !defined(__EMSCRIPTEN__)
+    #define WORLD_STREAM_THREADED
+    #define JOB_SYSTEM_THREADED
+    #include <pthread.h>        // Required for: pthread_create(), pthread_mutex_lock(), pthread_cond_wait()
+    #if !defined(_WIN32)
+        #include <unistd.h>     // Required for: sysconf()
+    #endif
+#endif
+
+// SIMD kernels pick the widest instruction set enabled at compile time
+#if defined(__AVX__)
+    #include <immintrin.h>
+#elif defined(__SSE__)
+    #include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+    #include <arm_neon.h>
+#endif
+
+// Instancing shaders: GLSL 330 on desktop, GLSL 100 on GLES2 targets
+#if defined(PLATFORM_ANDROID) || defined(__EMSCRIPTEN__)
+    #define GLSL_VERSION 100
+#else
+    #define GLSL_VERSION 330
+#endif
+
+// High-resolution timer for the profiler, declared by hand so windows.h doesn't clash with raylib
+#if defined(_WIN32)
+    __declspec(dllimport) int __stdcall QueryPerformanceCounter(long long *lpPerformanceCount);
+    __declspec(dllimport) int __stdcall QueryPerformanceFrequency(long long *lpFrequency);
+    __declspec(dllimport) unsigned long __stdcall GetActiveProcessorCount(unsigned short GroupNumber);
+#endif
+
+// Entity components, every archetype keeps the ones it has in packed arrays
+typedef struct {
+    Vector3 position;           // Feet position, the collider stands on y and is centred on x and z
+    Vector3 previousPosition;   // Position at the previous simulation tick, for render interpolation
+} TransformComponent;
+
+typedef struct {
+    Vector3 velocity;           // Units per second, x and z are set by input or AI every tick
+    float speed;                // Horizontal speed, units per second
+} VelocityComponent;
+
+typedef struct {
+    int health;
+    int maxHealth;
+} HealthComponent;
+
+typedef struct {
+    bool isHit;                 // Flashing red and invulnerable
+    float hitTimer;
+    float duration;             // Invulnerability period after a hit
+} HitFlashComponent;
 
 typedef struct {
-    Vector3 position;
     Vector3 size;
-    float speed;
-    Texture2D texture;
+} ColliderComponent;
+
+typedef enum {
+    SPRITE_PLAYER = 0,
+    SPRITE_ENEMY,
+    SPRITE_COUNT
+} SpriteId;
+
+typedef struct {
+    SpriteId texture;           // Resolved to a texture by the renderer, the simulation never loads any
+    bool healthBar;
+} SpriteComponent;
+
+// Input-driven motion: facing, jumping and gravity
+typedef struct {
     int direction;  // 0: down, 1: right, 2: up, 3: left
-    
-    // New physics parameters
-    Vector3 velocity;
+    bool jumpRequested;         // Set by the input, consumed by the gravity step
     bool isGrounded;
     float jumpForce;
     float gravity;
-    
-    // Health system
-    int health;
-    bool isHit;
-    float hitTimer;
-} Player;
+} ControllerComponent;
 
-// New Enemy struct
+// Enemy AI: shoot at the player periodically
 typedef struct {
-    Vector3 position;
-    Vector3 size;
-    float speed;
-    Texture2D texture;
-    
-    // Enemy behavior
     float shootTimer;
     float shootCooldown;
-    bool active;
-    
-    // Health system
-    int health;
-    bool isHit;
-    float hitTimer;
-} Enemy;
+} ShooterComponent;
+
+typedef enum {
+    COMPONENT_TRANSFORM = 1 << 0,
+    COMPONENT_VELOCITY = 1 << 1,
+    COMPONENT_HEALTH = 1 << 2,
+    COMPONENT_HIT_FLASH = 1 << 3,
+    COMPONENT_COLLIDER = 1 << 4,
+    COMPONENT_SPRITE = 1 << 5,
+    COMPONENT_CONTROLLER = 1 << 6,
+    COMPONENT_SHOOTER = 1 << 7
+} ComponentFlag;
+
+// Linear allocator: pushes bump a cursor through one block, a reset releases everything at once
+// NOTE: A push that doesn't fit gets a heap block of its own, the next reset folds them into one
+// block as big as the peak, so once a frame (or a floor) has been seen it makes no heap calls
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+} ArenaBlock;
 
-// New Bullet struct
 typedef struct {
-    Vector3 position;
-    Vector3 direction;
-    float speed;
-    float radius;
-    Color color;
-    bool active;
-    bool fromPlayer;  // Flag to determine if bullet is from player or enemy
-} Bullet;
-
-#define MAX_ENEMIES 100
-#define MAX_BULLETS 500
+    unsigned char *base;
+    size_t size;
+    size_t used;
+    size_t pushed;              // Bytes pushed since the last reset, overflow blocks included
+    ArenaBlock *overflow;       // Heap blocks of the pushes that didn't fit, freed by the reset
+} MemoryArena;
+
+#define ARENA_ALIGNMENT 16
+
+// CPU-side copy of the cubicmap used for collision queries
+// One byte per cell: 1 for wall, 0 for open floor
+typedef struct {
+    unsigned char *cells;
+    int width;
+    int height;
+} CollisionGrid;
+
+// Map collision context, built once when the level loads
+// Holds everything the collision routines need in world space
+// NOTE: One byte per cell, wall boxes are derived from the cell coordinates on demand.
+// The cells and clearance come from the level arena, like every grid sized after the map
+typedef struct {
+    CollisionGrid grid;
+    Vector3 position;           // World position the map model is drawn at
+    BoundingBox bounds;         // World-space bounds of the whole map
+    float *clearance;           // Per cell, distance from anywhere in the cell to the nearest wall or the map edge
+} MapCollision;
+
+// Walk over the grid cells a segment crosses, in order (DDA)
+typedef struct {
+    int cellX;                  // Cell being visited, may be outside the map
+    int cellZ;
+    float enter;                // Segment fractions where it enters and leaves the cell
+    float leave;
+    int stepX;
+    int stepZ;
+    float crossX;               // Segment fraction taken to cross one cell on each axis
+    float crossZ;
+    float nextX;                // Fraction at which the next boundary on each axis is crossed
+    float nextZ;
+    int cellsLeft;
+} GridMarch;
+
+// Cached line list for the wall wireframe debug overlay
+// Built from the collision grid, shared cube edges are only stored once
+typedef struct {
+    Vector3 *vertices;          // Two vertices per line
+    int vertexCount;
+} MapWireframe;
+
+// Baked level assets, written by game --bake so startup skips PNG decoding and mesh generation
+// File layout: header, images, collision grid, chunk meshes, every block padded to 4 bytes
+// NOTE: Native byte order, bake on the same kind of machine the bundle ships to
+#define ASSET_BUNDLE_FILE "resources/level.bundle"
+#define ASSET_BUNDLE_MAGIC 0x4c444e42       // "BNDL"
+#define ASSET_BUNDLE_VERSION 3
+
+typedef enum {
+    BUNDLE_IMAGE_PLAYER = 0,
+    BUNDLE_IMAGE_ENEMY,
+    BUNDLE_IMAGE_ATLAS,
+    BUNDLE_IMAGE_MAP,
+    BUNDLE_IMAGE_COUNT
+} BundleImageId;
+
+typedef struct {
+    unsigned int magic;
+    unsigned int version;
+    int chunkSize;              // MAP_CHUNK_SIZE the meshes were cut with
+    int imageCount;
+    int gridWidth;
+    int gridHeight;
+    int chunksX;
+    int chunksZ;
+    long long sourceTimes[BUNDLE_IMAGE_COUNT];      // Modification time of the file each image was baked from
+    int sourceSizes[BUNDLE_IMAGE_COUNT];            // Its size, -1 if it was missing at bake time
+} AssetBundleHeader;
+
+// Precedes the pixel data of every image, which is stored decoded in its upload format
+typedef struct {
+    int width;
+    int height;
+    int mipmaps;
+    int format;
+    int dataSize;               // 0 when the source image was missing at bake time
+} AssetBundleImage;
+
+// Chunk mesh as GenMeshMapChunk() builds it, the arrays point into the bundle
+typedef struct {
+    int vertexCount;
+    const float *vertices;
+    const float *texcoords;
+    const float *normals;
+} BundleMesh;
+
+// Read and write position in a bundle buffer, a NULL buffer only counts bytes
+typedef struct {
+    unsigned char *data;
+    int size;
+    int offset;
+} BundleCursor;
+
+// Loaded with a single read, images, grid and meshes all point into that one buffer
+typedef struct {
+    unsigned char *data;
+    Image images[BUNDLE_IMAGE_COUNT];   // Not owned, upload with LoadTextureFromImage()
+    CollisionGrid grid;                 // Not owned, copy before building a MapCollision from it
+    int chunksX;
+    int chunksZ;
+    BundleMesh *chunks;                 // [chunkZ*chunksX + chunkX]
+} AssetBundle;
+
+#define ENEMY_POOL_CAPACITY 64      // Initial pool sizes, both pools double whenever a spawn finds them full
+#define BULLET_POOL_CAPACITY 256
+#define MAX_NEARBY_ENEMIES 256      // Enemies tested per bullet, far more than a 3x3 cell neighbourhood holds in play
 #define ENEMY_SHOOT_COOLDOWN 2.0f
-#define BULLET_SPEED 0.3f
+#define BULLET_SPEED 18.0f          // Units per second
 #define BULLET_RADIUS 0.15f
+#define BULLET_MAX_DISTANCE 50.0f
+#define SWEEP_SKIN 0.0001f          // Gap left between a swept box and the wall it stopped at
+#define SWEEP_ITERATIONS 3          // Stop-and-slide passes per move, enough to settle into a corner
+#define PLAYER_BULLET_COLOR YELLOW
+#define ENEMY_BULLET_COLOR RED
+
+// Simulation runs on a fixed tick, independent of the render frame rate
+#define SIMULATION_TICK_RATE 60
+#define SIMULATION_TICK_TIME (1.0f/SIMULATION_TICK_RATE)
+#define MAX_FRAME_TIME 0.25f        // Clamp long frames so the simulation can catch up without spiralling
+
+// Rendering
+#define MAP_CHUNK_SIZE 8            // Map cells per mesh chunk side
+#define WORLD_STREAM_RADIUS 4       // Chunks kept resident on each side of the player's chunk
+#define WORLD_STREAM_SIDE (2*WORLD_STREAM_RADIUS + 1)
+#define WORLD_STREAM_SLOTS (WORLD_STREAM_SIDE*WORLD_STREAM_SIDE)
+#define WORLD_STREAM_UPLOADS 8      // Built chunks uploaded to the GPU per frame at most
+#define MAX_DRAW_DISTANCE 60.0f     // Far plane used for culling, past the furthest ground the zoomed-out camera sees
+#define ATLAS_PAGE_WIDTH 512        // Sprite atlas width, the height grows to the next power of two that fits
+#define ATLAS_PADDING 2             // Transparent texels around every atlas region
+#define ATLAS_SPRITE_HEIGHT 256     // Taller sprite images are scaled down when packed, a billboard never covers that much screen
+#define HUD_FONT_SIZE 20            // font.ttf is rasterized once at this size, larger HUD text scales it
+#define HUD_FONT_GLYPHS 95          // Printable ASCII
+#define HUD_TEXT_LENGTH 96          // Longest HUD label, including the terminator
+
+// Procedural floors
+#define DUNGEON_SIZE 64             // Default floor side in cells, --dungeon-size picks another
+#define DUNGEON_SIZE_MAX 1024
+#define DUNGEON_MAX_ROOMS 24        // Per DUNGEON_SIZE*DUNGEON_SIZE cells, larger floors get proportionally more
+#define DUNGEON_ROOM_ATTEMPTS 200   // Random placements tried per DUNGEON_MAX_ROOMS before the floor is considered full
+#define DUNGEON_ROOM_MIN 4          // Room side in cells
+#define DUNGEON_ROOM_MAX 10
+#define DUNGEON_ENEMY_DISTANCE 8    // Enemies spawn at least this many cells away from the player
+
+// Densely packed bullet pool: live bullets are always [0..count-1]
+// Spawning appends, despawning swaps the last live bullet into the freed slot
+// Stored as structure-of-arrays so the integration kernel streams only hot data
+// NOTE: Every array holds capacity entries and grows by doubling when a spawn finds the pool full
+typedef struct {
+    // Hot data, touched every frame
+    float *positionX;
+    float *positionY;
+    float *positionZ;
+    float *velocityX;           // Direction already scaled by speed (units per second)
+    float *velocityY;
+    float *velocityZ;
+
+    // Cold data
+    float *previousX;           // Position at the previous tick, for render interpolation
+    float *previousY;
+    float *previousZ;
+    float *radius;
+    bool *fromPlayer;           // Flag to determine if bullet is from player or enemy
+    unsigned char *expired;     // Scratch flags written by the integration kernel
+
+    int count;
+    int capacity;
+} BulletPool;
+
+typedef enum {
+    CHUNK_EMPTY = 0,            // Nothing to show: slot unused or chunk outside the map
+    CHUNK_QUEUED,               // Waiting for the worker, or being built right now
+    CHUNK_BUILT,                // CPU-side mesh ready, waiting for upload on the main thread
+    CHUNK_READY                 // Uploaded and drawable
+} WorldChunkState;
+
+// One resident map chunk: render mesh plus the wall wireframe of its cells
+typedef struct {
+    int chunkX;
+    int chunkZ;
+    int generation;             // Bumped on every reassignment, stale worker results are dropped
+    WorldChunkState state;
+    bool inQueue;
+    bool drawable;              // Main thread only: mesh is on the GPU, safe to draw without the lock
+    Mesh mesh;
+    MapWireframe wireframe;
+    BoundingBox bounds;         // World-space bounds
+    Matrix transform;           // Chunk offset inside the map plus the map position
+} WorldChunk;
+
+// Map meshes streamed around the player in a fixed window of chunk slots
+// Slots wrap around (chunk x, z lives in slot [(z mod side)*side + x mod side]),
+// so moving one chunk only rebuilds the row or column that fell out of the window
+// NOTE: Only render data is streamed. The collision grid, the fields built from it (clearance, flow field,
+// visibility, spatial grid) and the minimap texture are loaded whole per level, so their memory and load
+// time still grow with the cell count, try game --dungeon-size 512 or the dungeon-512 benchmark.
+// Slot state, the job queue and handed-over meshes are guarded by the mutex,
+// everything else is only touched by the main thread
+typedef struct {
+    const MapCollision *map;    // Read-only while the stream is running
+    const AssetBundle *bundle;  // Baked chunk meshes for this map, NULL to generate them
+    Material material;          // Shared, only references the atlas texture
+    int chunksX;
+    int chunksZ;
+    int centerX;                // Chunk the window is centred on
+    int centerZ;
+    bool centered;
+    WorldChunk slots[WORLD_STREAM_SLOTS];
+    int jobs[WORLD_STREAM_SLOTS];       // Slot indices waiting for the worker, ring buffer
+    int jobHead;
+    int jobCount;
+#if defined(WORLD_STREAM_THREADED)
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;
+    bool quit;
+#endif
+} WorldStream;
+
+#define MAX_JOB_THREADS 7           // Worker threads on top of the calling thread
+#define ENEMY_JOB_SIZE 64           // Enemies per AI job
+
+typedef void (*JobFunction)(void *data, int job);
+
+// Fixed pool of worker threads running parallel-for batches
+// The caller posts jobs [0..jobCount-1], helps run them, and returns once all are finished
+// NOTE: One batch at a time, only the main thread posts work
+typedef struct {
+    int threadCount;
+    JobFunction function;
+    void *data;
+    int jobCount;
+    int nextJob;                // First job not claimed yet
+    int finishedJobs;
+#if defined(JOB_SYSTEM_THREADED)
+    pthread_t threads[MAX_JOB_THREADS];
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;        // Workers wait here for a batch
+    pthread_cond_t done;        // The caller waits here for the last job
+    bool quit;
+#endif
+} JobSystem;
+
+// View frustum as six inward-facing planes: xyz is the unit normal, w the distance
+typedef struct {
+    Vector4 planes[6];
+} Frustum;
+
+// Bullet renderer: one low-poly unit sphere uploaded once, every bullet of a side drawn in one instanced call
+typedef struct {
+    Mesh mesh;
+    Material material;
+    bool instanced;             // False when the instancing shader failed to load, then it's one DrawMesh() per bullet
+} BulletRenderer;
+
+// Camera-facing quad queued for the sprite batch
+typedef struct {
+    unsigned int textureId;
+    Rectangle source;           // Normalized texture coordinates
+    Vector3 position;           // Quad centre
+    Vector2 size;               // World units
+    Color tint;
+} Sprite;
+
+typedef enum {
+    ATLAS_REGION_PLAYER = 0,
+    ATLAS_REGION_ENEMY,
+    ATLAS_REGION_WHITE,         // Solid texels for flat quads and raylib's shape drawing
+    ATLAS_REGION_FONT,          // Glyph page of the HUD font
+    ATLAS_REGION_COUNT
+} AtlasRegionId;
+
+// Every sprite, the HUD font and a white block packed into one texture page,
+// so billboards, health bars, HUD shapes and HUD text all draw with the same bind
+typedef struct {
+    Texture2D texture;
+    Rectangle regions[ATLAS_REGION_COUNT];  // Texel rects in the page
+    Font font;                  // Glyph rects point into the page, the default font if font.ttf failed to load
+} TextureAtlas;
+
+// One glyph quad of a laid-out HUD label
+typedef struct {
+    Rectangle source;           // Normalized texture coordinates on the font page
+    Rectangle dest;             // Screen pixels
+} HudGlyph;
+
+// HUD string with its glyph quads, laid out again only when the text, position or size changes
+typedef struct {
+    char text[HUD_TEXT_LENGTH];
+    int posX;
+    int posY;
+    int fontSize;
+    Color color;                // Applied at draw time, changing it costs no layout
+    HudGlyph glyphs[HUD_TEXT_LENGTH];
+    int glyphCount;
+} HudText;
+
+// Labels at or after HUD_LABEL_BANNER are drawn over the pause overlay
+typedef enum {
+    HUD_LABEL_FPS = 0,
+    HUD_LABEL_POSITION,
+    HUD_LABEL_VELOCITY,
+    HUD_LABEL_HEALTH,
+    HUD_LABEL_FLOOR,
+    HUD_LABEL_HELP_MOVE,
+    HUD_LABEL_HELP_SHOOT,
+    HUD_LABEL_HELP_DEBUG,
+    HUD_LABEL_BANNER,
+    HUD_LABEL_BANNER_HINT,
+    HUD_LABEL_COUNT
+} HudLabelId;
+
+// HUD text layer, numeric labels are only formatted again when the value they show changes
+typedef struct {
+    HudText labels[HUD_LABEL_COUNT];
+    bool ready;                 // Static labels laid out
+    int fps;                    // Values the dynamic labels were last formatted from
+    Vector3 position;
+    Vector3 velocity;
+    int floor;
+    bool recording;
+    int banner;                 // 0 none, 1 paused, 2 game over
+} HudLayer;
+
+// Minimap walls and border cached at screen scale, only the markers are drawn every frame
+typedef struct {
+    RenderTexture2D target;     // Redrawn only when the map changes
+    Vector2 position;           // Top-left corner on screen
+    float scale;                // Pixels per map cell
+} Minimap;
+
+// Billboard batcher: quads are queued during the frame and emitted grouped by texture,
+// so each texture costs one draw call instead of one per billboard
+// NOTE: The queue comes from the frame arena, so it only lives until the next frame starts
+typedef struct {
+    Sprite *sprites;
+    int count;
+    int capacity;               // Doubles when a frame queues more sprites, the next frames start at that size
+    Vector3 right;              // Camera basis, computed once per batch
+    Vector3 up;
+} SpriteBatch;
+
+// Uniform spatial hash over the cubicmap cells, rebuilt every frame
+// Entities are counting-sorted by cell so each cell is a contiguous run of indices
+// NOTE: Buckets are the map's cells, positions map to them through GetMapCell() like every other grid here.
+// Queries look at the 3x3 cells around a point, valid while entity reach stays under one cell
+typedef struct {
+    int width;
+    int height;
+    int capacity;               // Entities the arrays hold, grown when a build needs more
+    int *cellStart;             // Entries of cell c are entries[cellStart[c]..cellStart[c + 1]-1]
+    int *entries;               // Entity indices sorted by cell
+    int *entityCell;            // Scratch: cell of every inserted entity, -1 if skipped
+} SpatialGrid;
+
+#define FLOW_FIELD_UNREACHED 0xFFFF
+
+// Dijkstra map towards the player over the map cells
+// Rebuilt with one BFS only when the player changes cell, then every enemy reads its next step in O(1)
+// NOTE: Indexed like the map's collision grid, the map does the world-to-cell lookup
+typedef struct {
+    int width;
+    int height;
+    int targetCell;             // Cell the field leads to, -1 when it has to be rebuilt
+    unsigned short *distance;   // BFS steps to the target cell, FLOW_FIELD_UNREACHED for walls and cut-off cells
+    int *next;                  // Neighbour one step closer to the target (diagonals included), -1 at the target or unreached
+    int *queue;                 // BFS scratch
+} FlowField;
+
+#define VISIBILITY_RADIUS 11        // Cells, a little past the enemy shooting range
+
+// Field of view from the player's cell, recomputed with shadowcasting only when the player changes cell
+// Enemies check whether their cell is lit in O(1) before shooting
+// NOTE: Indexed like the map's collision grid, the map does the world-to-cell lookup
+typedef struct {
+    int width;
+    int height;
+    int viewerCell;             // Cell the view is cast from, -1 when it has to be rebuilt
+    unsigned char *visible;     // 1 for cells seen from the viewer cell within VISIBILITY_RADIUS, walls included
+} VisibilityGrid;
+
+// Bullet an enemy wants to fire, queued by the parallel AI phase and spawned in enemy order afterwards
+typedef struct {
+    int enemy;
+    Vector3 position;
+    Vector3 direction;
+} BulletCommand;
+
+// Forward declaration, job data below points at archetypes
+typedef struct Archetype Archetype;
+
+// Shared input of the enemy AI jobs, job j owns enemies [j*ENEMY_JOB_SIZE..] and the same range of commands
+typedef struct {
+    Archetype *enemies;
+    Vector3 target;             // Player position snapshot, jobs never see the player move mid-tick
+    float deltaTime;
+    const MapCollision *map;
+    const FlowField *flowField;
+    const VisibilityGrid *visibility;
+    BulletCommand *commands;
+    int *commandCounts;         // Commands queued by each job
+} EnemyJobData;
+
+// Shared input of the movement jobs, job j moves entities [j*ENEMY_JOB_SIZE..] of one archetype
+typedef struct {
+    Archetype *archetype;
+    float deltaTime;
+    const MapCollision *map;
+} MovementJobData;
+
+// Input for one simulation tick, sampled from devices once per frame
+// One-shot actions stay latched until a tick consumes them
+typedef struct {
+    bool moveRight;
+    bool moveLeft;
+    bool moveDown;
+    bool moveUp;
+    bool jump;
+    bool shoot;
+    Ray shootRay;               // Mouse ray captured when shoot was pressed
+} GameInput;
 
 typedef enum {
     GAME_PLAYING,
-    GAME_PAUSED
+    GAME_PAUSED,
+    GAME_OVER                   // Player died, only a checkpoint restore leaves it
 } GameState;
 
-bool CheckCollisionPlayerWithMap(Player *player, Model model, Vector3 mapPosition, Texture2D cubicmap);
-void UpdateGameCamera(Camera *camera, Player player);
-BoundingBox GetPlayerBoundingBox(Player player);
-void UpdatePlayerPhysics(Player *player, float deltaTime, Model model, Vector3 mapPosition, Texture2D cubicmap);
-bool CheckCollisionSphereBox(Vector3 center, float radius, BoundingBox box);
-BoundingBox GetEnemyBoundingBox(Enemy enemy);
-void UpdateEnemies(Enemy *enemies, int enemyCount, Player player, Bullet *bullets, int *bulletCount, float deltaTime, Model model, Vector3 mapPosition, Texture2D cubicmap);
-void ShootBullet(Bullet *bullets, int *bulletCount, Vector3 position, Vector3 direction, bool fromPlayer);
-void UpdateBullets(Bullet *bullets, int bulletCount, float deltaTime);
-bool CheckCollisionBulletWithMap(Bullet bullet, Model model, Vector3 mapPosition, Texture2D cubicmap);
-void CheckBulletCollisions(Bullet *bullets, int bulletCount, Player *player, Enemy *enemies, int enemyCount, Model model, Vector3 mapPosition, Texture2D cubicmap);
+typedef enum {
+    ARCHETYPE_PLAYER = 0,       // Exactly one entity, the player is always index 0
+    ARCHETYPE_ENEMY,
+    ARCHETYPE_COUNT
+} ArchetypeId;
 
-int main(void)
-{
-    const int screenWidth = 800;
-    const int screenHeight = 450;
+#define ARCHETYPE_PLAYER_COMPONENTS (COMPONENT_TRANSFORM | COMPONENT_VELOCITY | COMPONENT_HEALTH | COMPONENT_HIT_FLASH | COMPONENT_COLLIDER | COMPONENT_SPRITE | COMPONENT_CONTROLLER)
+#define ARCHETYPE_ENEMY_COMPONENTS (COMPONENT_TRANSFORM | COMPONENT_VELOCITY | COMPONENT_HEALTH | COMPONENT_HIT_FLASH | COMPONENT_COLLIDER | COMPONENT_SPRITE | COMPONENT_SHOOTER)
 
-    InitWindow(screenWidth, screenHeight, "roguelike");
+// Stable reference to an entity, valid until that entity is removed
+// NOTE: The generation tells a reused slot apart from the entity it used to hold, 0 is never used so a zeroed handle is always stale
+typedef struct {
+    int archetype;
+    int slot;
+    unsigned int generation;
+} EntityHandle;
 
-    Camera camera = { 0 };
-    camera.position = (Vector3){ 16.0f, 18.0f, 16.0f };     // Camera position
-    camera.target = (Vector3){ 0.0f, 0.0f, 0.0f };          // Camera looking at point
-    camera.up = (Vector3){ 0.0f, 1.0f, 0.0f };              // Camera up vector (rotation towards target)
-    camera.fovy = 45.0f;                                    // Camera field-of-view Y
-    camera.projection = CAMERA_PERSPECTIVE;                 // Camera projection type
+// Entities sharing one set of components, each component in its own packed array
+// Live entities are [0..count-1] so systems only visit the living, removing swaps
+// the last entity into the hole and the slot table keeps every handle pointing at its entity
+struct Archetype {
+    unsigned int components;    // ComponentFlag mask, arrays of the other components stay NULL
+    int count;
+    int capacity;               // Every array grows together by doubling
 
-    Player player = {0};
-    player.position = (Vector3){ 0.0f, 0.5f, -2.0f };
-    // Make player smaller to fit in 1-cube spaces
-    player.size = (Vector3){ 0.5f, 0.5f, 0.5f };
-    player.speed = 0.25f;
-    player.texture = LoadTexture("resources/player.png");
-    player.direction = 0;
-    
-    // Initialize physics parameters
-    player.velocity = (Vector3){ 0.0f, 0.0f, 0.0f };
-    player.isGrounded = true;
-    player.jumpForce = 0.2f;
-    player.gravity = 0.01f;
-    
-    // Initialize player health
-    player.health = 100;
-    player.isHit = false;
-    player.hitTimer = 0.0f;
-
-    // Initialize enemies
-    Enemy enemies[MAX_ENEMIES] = {0};
-    int enemyCount = 10; // Start with 10 enemies
-    
-    Texture2D enemyTexture = LoadTexture("resources/enemy.png");
-    if (!enemyTexture.id) {
-        // If enemy texture not found, use a default color instead
-        enemyTexture = player.texture; // Fallback to player texture
-    }
+    TransformComponent *transforms;
+    VelocityComponent *velocities;
+    HealthComponent *healths;
+    HitFlashComponent *hitFlashes;
+    ColliderComponent *colliders;
+    SpriteComponent *sprites;
+    ControllerComponent *controllers;
+    ShooterComponent *shooters;
+
+    int *denseSlot;             // Slot owning each dense entity
+    int *slotDense;             // Dense index of each used slot, next free slot of each unused one
+    unsigned int *slotGeneration;
+    int freeSlot;               // Head of the free slot list, -1 when every slot is used
+};
+
+// Everything the simulation mutates, shared by the windowed game and headless runs
+// NOTE: Owns the entity storage, call UnloadGameWorld() before initializing it again
+typedef struct {
+    Archetype archetypes[ARCHETYPE_COUNT];
+    BulletPool bullets;
     
-    // Initialize enemy positions randomly
-    for (int i = 0; i < enemyCount; i++) {
-        enemies[i].position = (Vector3){
-            GetRandomValue(0, 10) + 0.5f,
-            0.5f,
-            GetRandomValue(0, 10) + 0.5f
-        };
-        
-        enemies[i].size = (Vector3){ 0.5f, 0.5f, 0.5f };
-        enemies[i].speed = 0.13f; // Slower than player
-        enemies[i].texture = enemyTexture;
-        enemies[i].shootTimer = GetRandomValue(0, 100) / 100.0f * ENEMY_SHOOT_COOLDOWN; // Randomize initial shoot timer
-        enemies[i].shootCooldown = ENEMY_SHOOT_COOLDOWN;
-        enemies[i].active = true;
-        enemies[i].health = 30;
-        enemies[i].isHit = false;
-        enemies[i].hitTimer = 0.0f;
-    }
+    // Player shooting variables
+    bool canShoot;
+    float shootTimer;
+    float shootCooldown;
     
-    // Initialize bullets
-    Bullet bullets[MAX_BULLETS] = {0};
-    int bulletCount = 0;
+    GameState state;
+} GameWorld;
+
+// Copy of the simulation state, for restarting from a checkpoint and for rolling back
+// NOTE: The pools grow separately so their arrays can't share one allocation, the snapshot packs
+// every array in use back to back instead, one block that copies and serializes whole
+typedef struct {
+    GameWorld world;            // Counts, capacities, timers and state, its pointers are never followed
+    unsigned char *data;        // Entity and bullet arrays, kept between saves so a checkpoint doesn't allocate
+    int size;
+    int capacity;
+} GameSnapshot;
 
-    Image image = LoadImage("resources/map.png");           // Load map image (RAM)
-    Texture2D cubicmap = LoadTextureFromImage(image);       // Convert image to texture to display (VRAM)
+// Recorded session: the RNG seed plus the input of every simulated tick
+// File layout: header, then one record per tick, a flags byte followed by the values its flags announce
+#define REPLAY_MAGIC 0x594c5052     // "RPLY"
+#define REPLAY_VERSION 2
 
-    Mesh mesh = GenMeshCubicmap(image, (Vector3){ 1.0f, 1.0f, 1.0f });
-    Model model = LoadModelFromMesh(mesh);
+typedef enum {
+    REPLAY_MOVE_RIGHT = 1,
+    REPLAY_MOVE_LEFT = 2,
+    REPLAY_MOVE_DOWN = 4,
+    REPLAY_MOVE_UP = 8,
+    REPLAY_JUMP = 16,
+    REPLAY_SHOOT = 32,          // Followed by the shoot ray, 6 floats
+    REPLAY_WHEEL = 64,          // Followed by the mouse wheel movement since the last record, 1 float
+    REPLAY_RESTART = 128        // The world was restored from its checkpoint before this tick
+} ReplayTickFlag;
 
-    Texture2D texture = LoadTexture("resources/cubicmap_atlas.png");
-    model.materials[0].maps[MATERIAL_MAP_DIFFUSE].texture = texture;
+typedef struct {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int seed;          // RNG seed the session started from, also the first dungeon floor's seed
+    int dungeon;                // Side of the generated floors in cells, 0 when recorded on map.png
+    int tickCount;
+    unsigned int checksum;      // GetWorldChecksum() right after the last tick
+} ReplayHeader;
 
-    // Map dimensions (used for minimap calculations)
-    int mapWidth = image.width;
-    int mapHeight = image.height;
-    
-    Vector3 mapPosition = { -16.0f, 0.0f, -8.0f };          // Set model position
+typedef struct {
+    ReplayHeader header;
+    unsigned char *records;     // Tick records, variable length
+    int size;
+    int capacity;
+    int offset;                 // Playback position in records
+    int tick;                   // Ticks recorded or played back so far
+    float wheel;                // Recording: wheel movement waiting for the next tick record
+    bool restart;               // Recording: checkpoint restored since the last tick record
+} Replay;
 
-    UnloadImage(image);     // Unload map image from RAM, already uploaded to VRAM
+// Seeded input bot driving headless sessions
+typedef struct {
+    unsigned int rngState;      // Private generator so the bot doesn't consume the game's random stream
+    int moveX;                  // Current wander direction on each axis: -1, 0 or 1
+    int moveZ;
+    int retargetTicks;          // Ticks left until a new wander direction is picked
+    EntityHandle target;        // Enemy being shot at, kept until it dies or leaves range
+} InputBot;
 
-    GameState gameState = GAME_PLAYING;
-    
-    bool showWireframe = true;
-    
-    // Player shooting variables
-    bool canShoot = true;
-    float shootTimer = 0.0f;
-    float shootCooldown = 0.5f;
+// Profiled stages, zones may nest (wireframe is part of the 3D pass, everything is part of the frame)
+typedef enum {
+    PROFILE_INPUT = 0,
+    PROFILE_MOVEMENT,
+    PROFILE_ENEMIES,
+    PROFILE_BULLETS,
+    PROFILE_BULLET_COLLISIONS,
+    PROFILE_DRAW_3D,
+    PROFILE_WIREFRAME,
+    PROFILE_HUD,
+    PROFILE_FRAME,
+    PROFILE_ZONE_COUNT
+} ProfileZone;
 
-    SetTargetFPS(60);
+#define PROFILER_WINDOW 240         // Frames kept for the rolling min/avg/p99
 
-    while (!WindowShouldClose())        // Detect window close button or ESC key
+// Per-stage CPU timings, zones hit several times in a frame (one per tick) are summed
+// NOTE: Draw zones measure command submission, the GPU work is flushed later by rlgl
+typedef struct {
+    double zoneStart[PROFILE_ZONE_COUNT];
+    double zoneTime[PROFILE_ZONE_COUNT];                    // Seconds spent in the current frame
+    float history[PROFILE_ZONE_COUNT][PROFILER_WINDOW];     // Milliseconds, ring buffer
+    int historyHead;
+    int historyCount;
+    long frameIndex;
+    bool showOverlay;
+    FILE *csvFile;              // Per-frame timings are streamed here while recording
+} FrameProfiler;
+
+// Named benchmark setup, input comes from the input bot seeded with the same seed
+typedef struct {
+    const char *name;
+    int enemyCount;
+    int stormBullets;           // Extra player bullets fanned out every tick
+    bool wireframe;             // Draw the wireframe overlay (windowed runs only)
+    unsigned int seed;
+    int dungeonSize;            // Generated floor of this side in cells, 0 for map.png
+} BenchScenario;
+
+void UpdateGameCamera(Camera *camera, Vector3 target);
+BoundingBox GetEntityBoundingBox(TransformComponent transform, ColliderComponent collider);
+void LoadMapClearance(MapCollision *map);
+float GetMapClearance(const MapCollision *map, Vector3 position);
+bool CheckMapClearPath(const MapCollision *map, Vector3 start, Vector3 end, float radius);
+GridMarch InitGridMarch(const MapCollision *map, Vector3 start, Vector3 end);
+bool NextGridMarchCell(GridMarch *march);
+bool GetSweepHit(BoundingBox box, Vector3 step, BoundingBox obstacle, float *time, int *axis);
+Vector3 SweepBoxWithMap(BoundingBox box, Vector3 step, const MapCollision *map);
+bool CheckGroundContactWithMap(BoundingBox box, const MapCollision *map);
+bool ApplyDamage(HealthComponent *health, HitFlashComponent *hitFlash, int damage);
+bool CheckCollisionSphereBox(Vector3 center, float radius, BoundingBox box);
+void InitBulletPool(BulletPool *pool, int capacity);
+void UnloadBulletPool(BulletPool *pool);
+void GrowBulletPool(BulletPool *pool, int capacity);
+void ShootBullet(BulletPool *pool, Vector3 position, Vector3 direction, bool fromPlayer);
+void DespawnBullet(BulletPool *pool, int index);
+void UpdateBullets(BulletPool *pool, float deltaTime);
+void IntegrateBullets(BulletPool *pool, float deltaTime, float maxDistanceSqr);
+bool CheckCollisionBulletPathWithMap(Vector3 start, Vector3 end, float radius, const MapCollision *map);
+bool CheckCollisionBulletSpan(Vector3 start, Vector3 delta, float enter, float leave, float radius, const MapCollision *map);
+bool CheckCollisionSegmentBox(Vector3 start, Vector3 end, BoundingBox box);
+void CheckBulletCollisions(BulletPool *pool, Archetype *players, Archetype *enemies, const MapCollision *map, const SpatialGrid *enemyGrid);
+void *PushArena(MemoryArena *arena, size_t size);
+void ResetMemoryArena(MemoryArena *arena);
+void UnloadMemoryArena(MemoryArena *arena);
+CollisionGrid LoadCollisionGrid(Image image);
+CollisionGrid LoadCollisionGridCopy(const CollisionGrid *grid);
+bool IsCollisionGridWall(const CollisionGrid *grid, int x, int z);
+MapCollision LoadMapCollision(Image image, Vector3 position);
+MapCollision LoadMapCollisionFromGrid(CollisionGrid grid, Vector3 position);
+CollisionGrid GenCollisionGridDungeon(int width, int height, unsigned int seed, int *spawnX, int *spawnZ);
+void CarveCollisionGrid(CollisionGrid *grid, int x, int z, int width, int height);
+MapCollision LoadDungeonFloor(unsigned int seed, int size, Vector3 position, int *spawnX, int *spawnZ);
+Texture2D LoadCollisionGridTexture(const CollisionGrid *grid);
+void GetMapCell(const MapCollision *map, Vector3 position, int *cellX, int *cellZ);
+BoundingBox GetMapCellBox(const MapCollision *map, int cellX, int cellZ);
+bool GetMapWallBox(const MapCollision *map, int cellX, int cellZ, BoundingBox *box);
+MapWireframe LoadMapWireframe(const MapCollision *map, int cellX, int cellZ, int width, int height);
+void UnloadMapWireframe(MapWireframe wireframe);
+void DrawMapWireframe(const WorldStream *stream, const MapCollision *map, Vector3 playerPosition, const Frustum *frustum);
+void InitGameWorld(GameWorld *world, int enemyCount);
+void UnloadGameWorld(GameWorld *world);
+void SaveGameSnapshot(GameSnapshot *snapshot, const GameWorld *world);
+void RestoreGameSnapshot(GameWorld *world, const GameSnapshot *snapshot);
+void UnloadGameSnapshot(GameSnapshot *snapshot);
+int CopyGameWorldArrays(GameWorld *world, const GameWorld *layout, unsigned char *data, bool restore);
+void InitArchetype(Archetype *archetype, unsigned int components, int capacity);
+void UnloadArchetype(Archetype *archetype);
+void GrowArchetype(Archetype *archetype, int capacity);
+bool HasComponents(const Archetype *archetype, unsigned int components);
+int AddEntity(Archetype *archetype);
+void RemoveEntity(Archetype *archetype, int index);
+void RemoveDeadEntities(Archetype *archetype);
+EntityHandle GetEntityHandle(const GameWorld *world, int archetype, int index);
+int GetEntityIndex(const GameWorld *world, EntityHandle handle);
+void UpdateTransformHistory(GameWorld *world);
+void UpdateHitFlashes(GameWorld *world, float deltaTime);
+void UpdatePlayerControl(GameWorld *world, const GameInput *input);
+void UpdateEnemyAI(GameWorld *world, const MapCollision *map, const FlowField *flowField, const VisibilityGrid *visibility, float deltaTime);
+void UpdateEnemyAIJob(void *data, int job);
+void UpdateMovement(GameWorld *world, const MapCollision *map, float deltaTime);
+void UpdateMovementJob(void *data, int job);
+void UpdateGravity(GameWorld *world, const MapCollision *map, float deltaTime);
+void PlaceGameWorld(GameWorld *world, const MapCollision *map, int spawnX, int spawnZ);
+void UpdateGameWorld(GameWorld *world, const GameInput *input, const MapCollision *map, SpatialGrid *enemyGrid, FlowField *flowField, VisibilityGrid *visibility);
+int RunHeadless(int sessions, int ticks, unsigned int seed);
+void InitInputBot(InputBot *bot, unsigned int seed);
+GameInput UpdateInputBot(InputBot *bot, const GameWorld *world);
+SpatialGrid LoadSpatialGrid(const MapCollision *map, int capacity);
+int GetSpatialGridCell(const SpatialGrid *grid, const MapCollision *map, Vector3 position);
+void BuildSpatialGrid(SpatialGrid *grid, const MapCollision *map, const TransformComponent *transforms, int count);
+int QuerySpatialGrid(const SpatialGrid *grid, const MapCollision *map, Vector3 position, int *results, int maxResults);
+FlowField LoadFlowField(const MapCollision *map);
+int GetFlowFieldCell(const FlowField *field, const MapCollision *map, Vector3 position);
+void UpdateFlowField(FlowField *field, const MapCollision *map, Vector3 target);
+Vector3 GetFlowFieldDirection(const FlowField *field, const MapCollision *map, Vector3 position, Vector3 target);
+VisibilityGrid LoadVisibilityGrid(const MapCollision *map);
+void UpdateVisibilityGrid(VisibilityGrid *visibility, const MapCollision *map, Vector3 viewer);
+void CastVisibilityOctant(VisibilityGrid *visibility, const MapCollision *map, int row, float startSlope, float endSlope, int xx, int xz, int zx, int zz);
+bool IsVisibleFromViewer(const VisibilityGrid *visibility, const MapCollision *map, Vector3 position);
+BulletRenderer LoadBulletRenderer(void);
+void UnloadBulletRenderer(BulletRenderer renderer);
+void DrawBullets(BulletRenderer *renderer, const BulletPool *pool, float alpha, const Frustum *frustum);
+Mesh GenMeshMapChunk(const CollisionGrid *grid, int cellX, int cellZ, int width, int height);
+void InitWorldStream(WorldStream *stream, const MapCollision *map, const AssetBundle *bundle, Texture2D texture);
+void CloseWorldStream(WorldStream *stream);
+void UpdateWorldStream(WorldStream *stream, Vector3 focus);
+int DrawWorldStream(const WorldStream *stream, const Frustum *frustum);
+void AssignWorldChunk(WorldStream *stream, int slot, int chunkX, int chunkZ);
+void BuildWorldChunk(const MapCollision *map, const AssetBundle *bundle, int chunkX, int chunkZ, Mesh *mesh, MapWireframe *wireframe);
+void *WorldStreamWorker(void *data);
+void InitJobSystem(JobSystem *system, int threadCount);
+void CloseJobSystem(JobSystem *system);
+int GetJobThreadCount(void);
+void RunJobs(JobSystem *system, JobFunction function, void *data, int jobCount);
+void *JobSystemWorker(void *data);
+Frustum GetCameraFrustum(Camera camera, float aspect, float drawDistance);
+bool IsSphereInFrustum(const Frustum *frustum, Vector3 center, float radius);
+bool IsBoxInFrustum(const Frustum *frustum, BoundingBox box);
+SpriteBatch LoadSpriteBatch(void);
+void BeginSpriteBatch(SpriteBatch *batch, Camera camera);
+void AddSpriteBillboard(SpriteBatch *batch, const TextureAtlas *atlas, AtlasRegionId region, Vector3 position, float size, Color tint);
+void AddSpriteQuad(SpriteBatch *batch, const TextureAtlas *atlas, Vector3 position, Vector2 size, Color color);
+Sprite *PushSprite(SpriteBatch *batch);
+void EndSpriteBatch(SpriteBatch *batch);
+TextureAtlas LoadTextureAtlas(const AssetBundle *bundle);
+void UnloadTextureAtlas(TextureAtlas atlas);
+Image GenImageAtlas(Image *images, int count, Rectangle *regions);
+Rectangle GetAtlasTexCoords(const TextureAtlas *atlas, AtlasRegionId region);
+Image LoadBundleImage(const AssetBundle *bundle, BundleImageId image, const char *fileName);
+int MeasureHudText(const TextureAtlas *atlas, const char *text, int fontSize);
+void SetHudText(HudText *label, const TextureAtlas *atlas, const char *text, int posX, int posY, int fontSize, Color color);
+void UpdateHudLayer(HudLayer *hud, const TextureAtlas *atlas, const GameWorld *world, int floor, bool recording, int screenWidth, int screenHeight);
+void DrawHudLabels(const HudLayer *hud, const TextureAtlas *atlas, int first, int last);
+Minimap LoadMinimap(Texture2D cubicmap, int screenWidth);
+void UnloadMinimap(Minimap minimap);
+void DrawMinimap(const Minimap *minimap, const TextureAtlas *atlas, const GameWorld *world, Vector3 mapPosition);
+double GetProfilerTime(void);
+void BeginProfileZone(ProfileZone zone);
+void EndProfileZone(ProfileZone zone);
+void EndProfilerFrame(void);
+void GetProfileZoneStats(ProfileZone zone, float *min, float *avg, float *p99);
+int CompareProfileSamples(const void *a, const void *b);
+void DrawProfilerOverlay(int posX, int posY);
+bool StartProfilerCsv(const char *fileName);
+void StopProfilerCsv(void);
+const BenchScenario *FindBenchScenario(const char *name);
+void ApplyBenchScenario(const BenchScenario *scenario, GameWorld *world, int tick);
+int RunBenchmarkHeadless(const BenchScenario *scenario, int ticks);
+void PrintBenchmarkReport(const char *name, const char *mode, int ticks, double seconds, float *frameTimes);
+long GetPeakMemoryKB(void);
+void InitReplay(Replay *replay, unsigned int seed, int dungeonSize);
+bool LoadReplay(Replay *replay, const char *fileName);
+bool SaveReplay(const Replay *replay, const char *fileName);
+void UnloadReplay(Replay *replay);
+void RecordReplayTick(Replay *replay, const GameInput *input, unsigned int checksum);
+bool ReadReplayTick(Replay *replay, GameInput *input, float *wheel);
+bool IsReplayRestartNext(const Replay *replay);
+bool IsReplayInSync(const Replay *replay, const GameWorld *world);
+int RunReplayHeadless(Replay *replay, const char *name);
+unsigned int GetWorldChecksum(const GameWorld *world);
+void AdvanceDungeonFloor(GameWorld *world, MapCollision *map, unsigned int seed, int floor);
+int BakeAssetBundle(const char *fileName);
+void WriteAssetBundle(BundleCursor *cursor, const Image *images, const CollisionGrid *grid, const Mesh *chunks, int chunksX, int chunksZ, const int *sourceSizes, const long long *sourceTimes);
+AssetBundle LoadAssetBundle(const char *fileName);
+void UnloadAssetBundle(AssetBundle bundle);
+MapCollision LoadLevelMapCollision(const AssetBundle *bundle, Vector3 position);
+Texture2D LoadBundleTexture(const AssetBundle *bundle, BundleImageId image, const char *fileName);
+int GetImageDataSize(Image image);
+void WriteBundleBytes(BundleCursor *cursor, const void *data, int size);
+const void *ReadBundleBytes(BundleCursor *cursor, int size);
+
+// Global so any stage can be timed without threading a context through every call
+FrameProfiler profiler = { 0 };
+
+// Zone labels for the overlay, the CSV columns are derived from the same names
+const char *profileZoneNames[PROFILE_ZONE_COUNT] = {
+    "input", "movement", "enemies", "bullets", "bullet collisions",
+    "3d pass", "wireframe", "hud/minimap", "cpu frame"
+};
+
+// Shared by every simulation stage that fans out, started by whichever mode main() runs
+JobSystem jobSystem = { 0 };
+
+// Transient allocations by lifetime: reset at the start of every frame (every tick when headless),
+// and whenever the map is replaced. Main thread only, the stream worker keeps using the heap
+MemoryArena frameArena = { 0 };
+MemoryArena levelArena = { 0 };
+
+// Benchmark scenarios, run with: game --bench <name>
+const BenchScenario benchScenarios[] = {
+    { "enemies-10", 10, 0, false, 1 },
+    { "enemies-100", 100, 0, false, 1 },
+    { "enemies-1000", 1000, 0, false, 1 },
+    { "bullet-storm", 10, 8, false, 1 },
+    { "wireframe", 10, 0, true, 1 },
+    { "dungeon-512", 100, 0, false, 1, 512 },
+};
+#define BENCH_SCENARIO_COUNT (int)(sizeof(benchScenarios)/sizeof(benchScenarios[0]))
+
+// Source file of every bundle image, indexed by BundleImageId
+const char *bundleSourceFiles[BUNDLE_IMAGE_COUNT] = {
+    "resources/player.png", "resources/enemy.png", "resources/cubicmap_atlas.png", "resources/map.png"
+};
+
+int main(int argc, char *argv[])
+{
+    // Bake mode: decode the source images and build the chunk meshes into one bundle, no window needed
+    // Usage: game --bake [file]
+    for (int i = 1; i < argc; i++)
     {
-        // Get frame time to ensure consistent physics regardless of framerate
-        float deltaTime = GetFrameTime();
-        
-        if (IsKeyPressed(KEY_P)) 
-        {
-            if (gameState == GAME_PLAYING) gameState = GAME_PAUSED;
-            else if (gameState == GAME_PAUSED) gameState = GAME_PLAYING;
-        }
-        
-        // Toggle wireframe display
-        if (IsKeyPressed(KEY_F))
+        if (strcmp(argv[i], "--bake") == 0)
         {
-            showWireframe = !showWireframe;
+            return BakeAssetBundle(((i + 1 < argc) && (argv[i + 1][0] != '-'))? argv[i + 1] : ASSET_BUNDLE_FILE);
         }
+    }
 
-        if (gameState == GAME_PLAYING)
-        {
-            // Update hit timer for player
-            if (player.isHit) {
-                player.hitTimer -= deltaTime;
-                if (player.hitTimer <= 0.0f) {
-                    player.isHit = false;
-                }
-            }
-        
-            // Store previous position
-            Vector3 previousPosition = player.position;
+    // Benchmark mode: fixed seed and scripted input, exactly one tick per frame, reports when done
+    // Usage: game --bench <scenario> [--ticks N] [--headless]
+    const BenchScenario *scenario = NULL;
+    int benchTicks = 20*SIMULATION_TICK_RATE;
 
-            // Player horizontal movement (no vertical movement here)
-            if (IsKeyDown(KEY_RIGHT) || IsKeyDown(KEY_D)) 
-            {
-                player.position.x += player.speed;
-                player.direction = 1;
-            }
-            else if (IsKeyDown(KEY_LEFT) || IsKeyDown(KEY_A)) 
-            {
-                player.position.x -= player.speed;
-                player.direction = 3;
-            }
-            
-            if (IsKeyDown(KEY_DOWN) || IsKeyDown(KEY_S)) 
-            {
-                player.position.z += player.speed;
-                player.direction = 0;
-            }
-            else if (IsKeyDown(KEY_UP) || IsKeyDown(KEY_W)) 
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--bench") == 0)
+        {
+            scenario = (i + 1 < argc)? FindBenchScenario(argv[i + 1]) : NULL;
+            if (scenario == NULL)
             {
-                player.position.z -= player.speed;
-                player.direction = 2;
+                printf("unknown benchmark scenario, available:");
+                for (int j = 0; j < BENCH_SCENARIO_COUNT; j++) printf(" %s", benchScenarios[j].name);
+                printf("\n");
+                return 1;
             }
-            
-            // Check horizontal movement collisions
-            if (CheckCollisionPlayerWithMap(&player, model, mapPosition, cubicmap))
+
+            bool headless = false;
+            for (int j = 1; j < argc; j++)
             {
-                player.position = previousPosition;  // Restore position if collision detected
+                if ((strcmp(argv[j], "--ticks") == 0) && (j + 1 < argc)) benchTicks = atoi(argv[j + 1]);
+                else if (strcmp(argv[j], "--headless") == 0) headless = true;
             }
-            
-            // Handle jumping - can always jump regardless of space constraints
-            if (IsKeyPressed(KEY_SPACE) && player.isGrounded)
+            if (benchTicks < 1) benchTicks = 1;
+
+            if (headless)
             {
-                player.velocity.y = player.jumpForce;
-                player.isGrounded = false;
-            }
-            
-            // Player shooting
-            if (!canShoot) {
-                shootTimer -= deltaTime;
-                if (shootTimer <= 0.0f) {
-                    canShoot = true;
-                }
-            }
-            
-            if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && canShoot) {
-                // Get mouse position in 3D world space
-                Ray ray = GetMouseRay(GetMousePosition(), camera);
-                
-                // Project the mouse ray onto the same y-plane as the player + 0.5f
-                float t = ((player.position.y + 0.5f) - ray.position.y) / ray.direction.y;
-                Vector3 targetPoint = Vector3Add(ray.position, Vector3Scale(ray.direction, t));
-                
-                // Calculate the direction vector from player to the projected point
-                Vector3 direction = Vector3Normalize(Vector3Subtract(
-                    targetPoint,
-                    (Vector3){ player.position.x, player.position.y + 0.5f, player.position.z }));
-                
-                // Force the y component to be zero to ensure horizontal shooting
-                direction.y = 0.0f;
-                
-                // Re-normalize after zeroing the y component
-                direction = Vector3Normalize(direction);
-                
-                // Shoot bullet
-                ShootBullet(bullets, &bulletCount, 
-                    (Vector3){ player.position.x, player.position.y + 0.5f, player.position.z }, 
-                    direction, true);
-                
-                canShoot = false;
-                shootTimer = shootCooldown;
+                InitJobSystem(&jobSystem, GetJobThreadCount());
+                int result = RunBenchmarkHeadless(scenario, benchTicks);
+                CloseJobSystem(&jobSystem);
+                return result;
             }
-            
-            // Update physics (vertical movement, gravity, ground detection)
-            UpdatePlayerPhysics(&player, deltaTime, model, mapPosition, cubicmap);
-            
-            // Update enemies
-            UpdateEnemies(enemies, enemyCount, player, bullets, &bulletCount, deltaTime, model, mapPosition, cubicmap);
-            
-            // Update bullets
-            UpdateBullets(bullets, bulletCount, deltaTime);
-            
-            // Check bullet collisions
-            CheckBulletCollisions(bullets, bulletCount, &player, enemies, enemyCount, model, mapPosition, cubicmap);
+        }
+    }
 
-            // Update camera to follow player
-            UpdateGameCamera(&camera, player);
-            
-            // Check game over condition
-            if (player.health <= 0) {
-                // You could add game over state here
-                gameState = GAME_PAUSED;
-            }
+    // Replay mode: record the input of a session, or play a recording back and check it ends up in the same state
+    // Usage: game --record <file> [--dungeon [seed]], game --replay <file> [--headless]
+    const char *recordFile = NULL;
+    const char *replayFile = NULL;
+    static Replay replay = { 0 };
+
+    for (int i = 1; (i < argc - 1) && (scenario == NULL); i++)
+    {
+        if (strcmp(argv[i], "--record") == 0) recordFile = argv[i + 1];
+        else if (strcmp(argv[i], "--replay") == 0) replayFile = argv[i + 1];
+    }
+
+    if (replayFile != NULL)
+    {
+        recordFile = NULL;
+        if (!LoadReplay(&replay, replayFile))
+        {
+            printf("cannot load replay %s\n", replayFile);
+            return 1;
         }
 
-        // Camera zoom control
-        float mouseWheel = GetMouseWheelMove();
-        if (mouseWheel != 0)
+        for (int i = 1; i < argc; i++)
         {
-            // Adjust camera height (zoom)
-            camera.position.y -= mouseWheel * 2.0f;
-            if (camera.position.y < 5.0f) camera.position.y = 5.0f;
-            if (camera.position.y > 30.0f) camera.position.y = 30.0f;
+            if (strcmp(argv[i], "--headless") == 0)
+            {
+                InitJobSystem(&jobSystem, GetJobThreadCount());
+                int result = RunReplayHeadless(&replay, GetFileName(replayFile));
+                CloseJobSystem(&jobSystem);
+                UnloadReplay(&replay);
+                return result;
+            }
         }
+    }
 
-        BeginDrawing();
+    // Headless mode: no window or GPU, simulate sessions as fast as the CPU allows
+    // Usage: game --headless [--sessions N] [--ticks N] [--seed N]
+    for (int i = 1; (i < argc) && (scenario == NULL) && (replayFile == NULL); i++)
+    {
+        if (strcmp(argv[i], "--headless") == 0)
+        {
+            int sessions = 1;
+            int ticks = 60*SIMULATION_TICK_RATE;
+            unsigned int seed = 1;
 
-            ClearBackground(BLACK);
+            for (int j = 1; j < argc - 1; j++)
+            {
+                if (strcmp(argv[j], "--sessions") == 0) sessions = atoi(argv[j + 1]);
+                else if (strcmp(argv[j], "--ticks") == 0) ticks = atoi(argv[j + 1]);
+                else if (strcmp(argv[j], "--seed") == 0) seed = (unsigned int)strtoul(argv[j + 1], NULL, 10);
+            }
 
-            BeginMode3D(camera);
+            InitJobSystem(&jobSystem, GetJobThreadCount());
+            int result = RunHeadless(sessions, ticks, seed);
+            CloseJobSystem(&jobSystem);
+            return result;
+        }
+    }
 
-                // Draw the 3D map
-                DrawModel(model, mapPosition, 1.0f, WHITE);
+    const int screenWidth = 800;
+    const int screenHeight = 450;
 
-                // Draw wireframes for collision cubes
-                if (showWireframe)
-                {
-                    // Load the cubicmap image to check which cubes should have wireframes
-                    Image cubicmapImage = LoadImageFromTexture(cubicmap);
-                    
-                    // Loop through all cells in the map
-                    for (int z = 0; z < cubicmap.height; z++)
-                    {
-                        for (int x = 0; x < cubicmap.width; x++)
-                        {
-                            // Get pixel color from cubicmap
-                            Color pixelColor = GetImageColor(cubicmapImage, x, z);
-                            
-                            // If the pixel is white (or close to white) - draw a wireframe cube
-                            if ((pixelColor.r > 200) && (pixelColor.g > 200) && (pixelColor.b > 200))
-                            {
-                                // Calculate the position of the cube in the 3D world
-                                Vector3 cubePosition = {
-                                    mapPosition.x + x, // Center of the cube
-                                    mapPosition.y + 0.5f,     // Center of the cube
-                                    mapPosition.z + z  // Center of the cube
-                                };
-                                
-                                // Draw wireframe cube
-                                DrawCubeWires(cubePosition, 1.0f, 1.0f, 1.0f, BLUE);
-                            }
-                        }
-                    }
-                    
-                    // Unload the image data
-                    UnloadImage(cubicmapImage);
-                }
+    InitWindow(screenWidth, screenHeight, "roguelike");
+
+    InitJobSystem(&jobSystem, GetJobThreadCount());
+
+    Camera camera = { 0 };
+    camera.position = (Vector3){ 16.0f, 18.0f, 16.0f };     // Camera position
+    camera.target = (Vector3){ 0.0f, 0.0f, 0.0f };          // Camera looking at point
+    camera.up = (Vector3){ 0.0f, 1.0f, 0.0f };              // Camera up vector (rotation towards target)
+    camera.fovy = 45.0f;                                    // Camera field-of-view Y
+    camera.projection = CAMERA_PERSPECTIVE;                 // Camera projection type
+
+    // Baked assets when game --bake has been run, every load below falls back to the source files
+    AssetBundle bundle = LoadAssetBundle(ASSET_BUNDLE_FILE);
+
+    // Sprites, the HUD font and raylib's shapes all draw from one atlas page
+    TextureAtlas atlas = LoadTextureAtlas(&bundle);
+    SetShapesTexture(atlas.texture, atlas.regions[ATLAS_REGION_WHITE]);
+
+    // Atlas regions, indexed by SpriteComponent.texture
+    const AtlasRegionId spriteRegions[SPRITE_COUNT] = { ATLAS_REGION_PLAYER, ATLAS_REGION_ENEMY };
+
+    // Procedural floors instead of map.png, a new floor is generated every time one is cleared
+    // Usage: game --dungeon [seed] [--dungeon-size <cells>]
+    bool dungeon = false;
+    unsigned int dungeonSeed = (unsigned int)time(NULL);
+    int dungeonSize = DUNGEON_SIZE;
+    int dungeonFloor = 1;
+    for (int i = 1; (i < argc) && (scenario == NULL) && (replayFile == NULL); i++)
+    {
+        if (strcmp(argv[i], "--dungeon") == 0)
+        {
+            dungeon = true;
+            if ((i + 1 < argc) && (argv[i + 1][0] != '-')) dungeonSeed = (unsigned int)strtoul(argv[i + 1], NULL, 10);
+        }
+        else if ((strcmp(argv[i], "--dungeon-size") == 0) && (i + 1 < argc))
+        {
+            dungeon = true;
+            dungeonSize = atoi(argv[i + 1]);
+        }
+    }
+
+    // A recording carries its own seed and map choice, everything random comes from that one seed
+    if (replayFile != NULL)
+    {
+        dungeon = (replay.header.dungeon != 0);
+        dungeonSeed = replay.header.seed;
+        dungeonSize = replay.header.dungeon;
+    }
+    else if ((scenario != NULL) && (scenario->dungeonSize > 0))
+    {
+        dungeon = true;
+        dungeonSeed = scenario->seed;
+        dungeonSize = scenario->dungeonSize;
+    }
+
+    if (dungeonSize < DUNGEON_ROOM_MIN + 2) dungeonSize = DUNGEON_ROOM_MIN + 2;
+    if (dungeonSize > DUNGEON_SIZE_MAX) dungeonSize = DUNGEON_SIZE_MAX;
+
+    unsigned int sessionSeed = dungeonSeed;
+    if (recordFile != NULL) InitReplay(&replay, sessionSeed, dungeon? dungeonSize : 0);
+
+    // Player, enemies and bullets
+    static GameWorld world = { 0 };
+    if (scenario != NULL)
+    {
+        SetRandomSeed(scenario->seed);
+        InitGameWorld(&world, scenario->enemyCount);
+    }
+    else
+    {
+        SetRandomSeed(sessionSeed);
+        InitGameWorld(&world, 10);    // Start with 10 enemies
+    }
+
+    Texture2D texture = LoadBundleTexture(&bundle, BUNDLE_IMAGE_ATLAS, "resources/cubicmap_atlas.png");
+
+    Vector3 mapPosition = { -16.0f, 0.0f, -8.0f };          // Set model position
+    MapCollision mapCollision = { 0 };
+    Texture2D cubicmap = { 0 };
+
+    if (dungeon)
+    {
+        // Generated straight into the collision grid, chunk meshes and the minimap are built from it
+        mapPosition = (Vector3){ -dungeonSize/2.0f, 0.0f, -dungeonSize/2.0f };
+
+        int spawnX = 0;
+        int spawnZ = 0;
+        mapCollision = LoadDungeonFloor(dungeonSeed, dungeonSize, mapPosition, &spawnX, &spawnZ);
+        cubicmap = LoadCollisionGridTexture(&mapCollision.grid);
+        PlaceGameWorld(&world, &mapCollision, spawnX, spawnZ);
+    }
+    else
+    {
+        // Baked pixels and cells when the bundle is current, otherwise decoded from map.png
+        // Collision never has to read back from the GPU or walk the mesh
+        cubicmap = LoadBundleTexture(&bundle, BUNDLE_IMAGE_MAP, bundleSourceFiles[BUNDLE_IMAGE_MAP]);
+        mapCollision = LoadLevelMapCollision(&bundle, mapPosition);
+    }
+
+    Minimap minimap = LoadMinimap(cubicmap, screenWidth);
+    static HudLayer hud = { 0 };
+
+    // Restart point after a game over, the start of the session or of the current floor
+    static GameSnapshot checkpoint = { 0 };
+    SaveGameSnapshot(&checkpoint, &world);
+
+    // Map meshes and wall wireframes are built from the collision grid per chunk, around the player only
+    static WorldStream worldStream = { 0 };
+    InitWorldStream(&worldStream, &mapCollision, &bundle, texture);
+
+    // Broadphase for bullet vs enemy tests, aligned to the map cells
+    SpatialGrid enemyGrid = LoadSpatialGrid(&mapCollision, ENEMY_POOL_CAPACITY);
+
+    // Enemy pathfinding towards the player, shared by all enemies
+    FlowField flowField = LoadFlowField(&mapCollision);
+    VisibilityGrid visibility = LoadVisibilityGrid(&mapCollision);
+
+    BulletRenderer bulletRenderer = LoadBulletRenderer();
+    SpriteBatch spriteBatch = LoadSpriteBatch();
+
+    bool showWireframe = (scenario != NULL)? scenario->wireframe : true;
+
+    // Fixed-step simulation state
+    GameInput input = { 0 };
+    float accumulator = 0.0f;
+
+    // Benchmark state, frame times include the buffer swap
+    InputBot benchBot = { 0 };
+    float *benchFrameTimes = NULL;
+    int benchTick = 0;
+    double benchStart = 0.0;
+    if (scenario != NULL)
+    {
+        InitInputBot(&benchBot, scenario->seed);
+        benchFrameTimes = (float *)MemAlloc(benchTicks*sizeof(float));
+        benchStart = GetProfilerTime();
+    }
+
+    // Replays are not tied to wall time either, or the same recording would play back at different speeds
+    int replayFrames = 0;
+    bool replayPaused = false;
+    float *replayFrameTimes = NULL;
+    double replayStart = 0.0;
+    if (replayFile != NULL)
+    {
+        replayFrameTimes = (float *)MemAlloc(((replay.header.tickCount > 0)? replay.header.tickCount : 1)*sizeof(float));
+        replayStart = GetProfilerTime();
+    }
+
+    SetTargetFPS(((scenario != NULL) || (replayFile != NULL))? 0 : 60);       // Render rate only, the simulation ticks at SIMULATION_TICK_RATE
 
-                // Draw the 2D player as billboard with hit effect
-                Color playerColor = player.isHit ? RED : WHITE;
-                DrawBillboard(camera, player.texture, 
-                    (Vector3){ player.position.x, player.position.y + 0.5f, player.position.z }, 
-                    1.0f, playerColor);
+    while (!WindowShouldClose())        // Detect window close button or ESC key
+    {
+        double frameStart = GetProfilerTime();
+        ResetMemoryArena(&frameArena);      // Nothing from the last frame is kept
+        BeginProfileZone(PROFILE_FRAME);
+        BeginProfileZone(PROFILE_INPUT);
+
+        // Get frame time to ensure consistent physics regardless of framerate
+        float deltaTime = GetFrameTime();
+        
+        if (IsKeyPressed(KEY_P) && (replayFile != NULL)) replayPaused = !replayPaused;
+        else if (IsKeyPressed(KEY_P)) 
+        {
+            if (world.state == GAME_PLAYING) world.state = GAME_PAUSED;
+            else if (world.state == GAME_PAUSED) world.state = GAME_PLAYING;
+        }
+
+        // Restart from the checkpoint, no asset is reloaded
+        if (IsKeyPressed(KEY_R) && (scenario == NULL) && (replayFile == NULL) && (world.state == GAME_OVER))
+        {
+            RestoreGameSnapshot(&world, &checkpoint);
+            if (recordFile != NULL) replay.restart = true;
+            input.jump = false;
+            input.shoot = false;
+            accumulator = 0.0f;
+        }
+        
+        // Toggle wireframe display
+        if (IsKeyPressed(KEY_F))
+        {
+            showWireframe = !showWireframe;
+        }
+
+        // Profiler overlay and CSV recording
+        if (IsKeyPressed(KEY_F3)) profiler.showOverlay = !profiler.showOverlay;
+        if (IsKeyPressed(KEY_F4))
+        {
+            if (profiler.csvFile == NULL) StartProfilerCsv("profile.csv");
+            else StopProfilerCsv();
+        }
+
+        // Sample devices once per frame, held keys are overwritten and presses latched
+        input.moveRight = IsKeyDown(KEY_RIGHT) || IsKeyDown(KEY_D);
+        input.moveLeft = IsKeyDown(KEY_LEFT) || IsKeyDown(KEY_A);
+        input.moveDown = IsKeyDown(KEY_DOWN) || IsKeyDown(KEY_S);
+        input.moveUp = IsKeyDown(KEY_UP) || IsKeyDown(KEY_W);
+        if (IsKeyPressed(KEY_SPACE)) input.jump = true;
+        if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON))
+        {
+            input.shoot = true;
+            input.shootRay = GetMouseRay(GetMousePosition(), camera);
+        }
+
+        EndProfileZone(PROFILE_INPUT);
+
+        float mouseWheel = GetMouseWheelMove();
+        bool floorCleared = dungeon && (world.archetypes[ARCHETYPE_ENEMY].count == 0);
+        bool replayTicked = false;
+
+        if (replayFile != NULL)
+        {
+            // One recorded tick per frame, a game over followed by more ticks means the session was resumed
+            if (replay.tick >= replay.header.tickCount) break;
+            if (!replayPaused)
+            {
+                if (IsReplayRestartNext(&replay))
+                {
+                    RestoreGameSnapshot(&world, &checkpoint);
+                    floorCleared = dungeon && (world.archetypes[ARCHETYPE_ENEMY].count == 0);
+                }
+                world.state = GAME_PLAYING;
+                if (!floorCleared && ReadReplayTick(&replay, &input, &mouseWheel))
+                {
+                    UpdateGameWorld(&world, &input, &mapCollision, &enemyGrid, &flowField, &visibility);
+                    replayTicked = true;
+                }
+            }
+            else mouseWheel = 0.0f;
+        }
+        else if (scenario != NULL)
+        {
+            // Scripted input replaces devices, ticks are not tied to wall time so every run simulates the same thing
+            input = UpdateInputBot(&benchBot, &world);
+            ApplyBenchScenario(scenario, &world, benchTick);
+            UpdateGameWorld(&world, &input, &mapCollision, &enemyGrid, &flowField, &visibility);
+        }
+        else if (world.state == GAME_PLAYING)
+        {
+            accumulator += fminf(deltaTime, MAX_FRAME_TIME);
+            
+            // Run as many fixed ticks as the elapsed time covers, stopping at a cleared floor so the
+            // next tick always runs on the next floor, live and in a replay
+            while ((accumulator >= SIMULATION_TICK_TIME) && (world.state == GAME_PLAYING) && !floorCleared)
+            {
+                UpdateGameWorld(&world, &input, &mapCollision, &enemyGrid, &flowField, &visibility);
+                if (recordFile != NULL) RecordReplayTick(&replay, &input, GetWorldChecksum(&world));
+                floorCleared = dungeon && (world.archetypes[ARCHETYPE_ENEMY].count == 0);
                 
-                // Draw enemies
-                for (int i = 0; i < enemyCount; i++) {
-                    if (enemies[i].active) {
-                        Color enemyColor = enemies[i].isHit ? RED : WHITE;
-                        DrawBillboard(camera, enemies[i].texture, 
-                            (Vector3){ enemies[i].position.x, enemies[i].position.y + 0.5f, enemies[i].position.z }, 
-                            1.0f, enemyColor);
+                // One-shot input has been consumed by this tick
+                input.jump = false;
+                input.shoot = false;
+                
+                accumulator -= SIMULATION_TICK_TIME;
+            }
+        }
+        else
+        {
+            // Don't replay presses made while paused
+            input.jump = false;
+            input.shoot = false;
+        }
+
+        // Floor cleared: swap in the next one, the player keeps their health
+        if (floorCleared && (world.state == GAME_PLAYING))
+        {
+            // The stream reads the grid from its worker, stop it before the grid goes away
+            CloseWorldStream(&worldStream);
+            UnloadTexture(cubicmap);
+
+            dungeonFloor++;
+            AdvanceDungeonFloor(&world, &mapCollision, dungeonSeed, dungeonFloor);
+            SaveGameSnapshot(&checkpoint, &world);
+            cubicmap = LoadCollisionGridTexture(&mapCollision.grid);
+            UnloadMinimap(minimap);
+            minimap = LoadMinimap(cubicmap, screenWidth);
+            InitWorldStream(&worldStream, &mapCollision, &bundle, texture);
+            enemyGrid = LoadSpatialGrid(&mapCollision, ENEMY_POOL_CAPACITY);
+            flowField = LoadFlowField(&mapCollision);
+            visibility = LoadVisibilityGrid(&mapCollision);
+            accumulator = 0.0f;
+        }
+        
+        // The player is the only entity of its archetype, the floor transition above may have moved its storage
+        const Archetype *players = &world.archetypes[ARCHETYPE_PLAYER];
+        const TransformComponent *playerTransform = &players->transforms[0];
+
+        // Blend factor between the last two ticks
+        float alpha = accumulator/SIMULATION_TICK_TIME;
+        Vector3 renderPlayerPosition = Vector3Lerp(playerTransform->previousPosition, playerTransform->position, alpha);
+        
+        // Update camera to follow player
+        UpdateGameCamera(&camera, renderPlayerPosition);
+
+        // Queue chunks entering the window around the player, upload finished ones
+        UpdateWorldStream(&worldStream, renderPlayerPosition);
+
+        // Camera zoom control, recorded with the next tick so a replay frames the same view
+        if (recordFile != NULL) replay.wheel += mouseWheel;
+        if (mouseWheel != 0)
+        {
+            // Adjust camera height (zoom)
+            camera.position.y -= mouseWheel * 2.0f;
+            if (camera.position.y < 5.0f) camera.position.y = 5.0f;
+            if (camera.position.y > 30.0f) camera.position.y = 30.0f;
+        }
+
+        BeginDrawing();
+
+            ClearBackground(BLACK);
+
+            BeginProfileZone(PROFILE_DRAW_3D);
+            BeginMode3D(camera);
+
+                // Visibility pass, everything below is tested against the camera frustum
+                Frustum frustum = GetCameraFrustum(camera, (float)screenWidth/screenHeight, MAX_DRAW_DISTANCE);
+
+                // Draw the 3D map
+                DrawWorldStream(&worldStream, &frustum);
+
+                // Draw wireframes for collision cubes and the cells around the player
+                if (showWireframe)
+                {
+                    BeginProfileZone(PROFILE_WIREFRAME);
+                    DrawMapWireframe(&worldStream, &mapCollision, playerTransform->position, &frustum);
+                    EndProfileZone(PROFILE_WIREFRAME);
+                }
+
+                // Player, enemies and health bars go through one sprite batch
+                BeginSpriteBatch(&spriteBatch, camera);
+
+                // Draw every entity with a sprite as a billboard with hit effect
+                for (int a = 0; a < ARCHETYPE_COUNT; a++) {
+                    const Archetype *archetype = &world.archetypes[a];
+                    if (!HasComponents(archetype, COMPONENT_TRANSFORM | COMPONENT_SPRITE)) continue;
+
+                    bool hasHitFlash = HasComponents(archetype, COMPONENT_HIT_FLASH);
+                    bool hasHealth = HasComponents(archetype, COMPONENT_HEALTH);
+
+                    for (int i = 0; i < archetype->count; i++) {
+                        const TransformComponent *transform = &archetype->transforms[i];
+                        const SpriteComponent *sprite = &archetype->sprites[i];
+
+                        // Sphere around the billboard and its health bar
+                        Vector3 position = Vector3Lerp(transform->previousPosition, transform->position, alpha);
+                        if (!IsSphereInFrustum(&frustum, (Vector3){ position.x, position.y + 0.5f, position.z }, 0.8f)) continue;
+
+                        Color color = (hasHitFlash && archetype->hitFlashes[i].isHit)? RED : WHITE;
+                        AddSpriteBillboard(&spriteBatch, &atlas, spriteRegions[sprite->texture], 
+                            (Vector3){ position.x, position.y + 0.5f, position.z }, 
+                            1.0f, color);
                             
-                        // Draw enemy health bar
-                        Vector3 healthBarPos = (Vector3){ 
-                            enemies[i].position.x, 
-                            enemies[i].position.y + 1.0f, 
-                            enemies[i].position.z 
-                        };
-                        
-                        float healthPercent = (float)enemies[i].health / 30.0f;
-                        DrawCube(
-                            Vector3Subtract(healthBarPos, (Vector3){ (1.0f - healthPercent) * 0.25f, 0, 0 }), 
-                            healthPercent * 0.5f, 0.1f, 0.1f, 
-                            (Color){ 255, (unsigned char)(healthPercent * 255), 0, 255 }
-                        );
+                        // Draw health bar, left-aligned so it shrinks towards the left edge
+                        if (sprite->healthBar && hasHealth) {
+                            float healthPercent = (float)archetype->healths[i].health / archetype->healths[i].maxHealth;
+                            Vector3 healthBarPos = Vector3Add(
+                                (Vector3){ position.x, position.y + 1.0f, position.z },
+                                Vector3Scale(spriteBatch.right, -(1.0f - healthPercent)*0.25f));
+                            
+                            AddSpriteQuad(&spriteBatch, &atlas, healthBarPos, (Vector2){ healthPercent*0.5f, 0.1f },
+                                (Color){ 255, (unsigned char)(healthPercent * 255), 0, 255 });
+                        }
                     }
                 }
+
+                EndSpriteBatch(&spriteBatch);
                 
                 // Draw bullets
-                for (int i = 0; i < bulletCount; i++) {
-                    if (bullets[i].active) {
-                        DrawSphere(bullets[i].position, bullets[i].radius, bullets[i].color);
-                    }
-                }
+                DrawBullets(&bulletRenderer, &world.bullets, alpha, &frustum);
                 
                 // Draw player's bounding box if enabled
                 if (showWireframe)
                 {
-                    BoundingBox mapBounds = GetModelBoundingBox(model);
-                    mapBounds.min = Vector3Add(mapBounds.min, mapPosition);
-                    mapBounds.max = Vector3Add(mapBounds.max, mapPosition);
-                    DrawBoundingBox(mapBounds, GREEN);
+                    DrawBoundingBox(mapCollision.bounds, GREEN);
 
-                    BoundingBox playerBox = GetPlayerBoundingBox(player);
+                    BoundingBox playerBox = GetEntityBoundingBox(*playerTransform, players->colliders[0]);
                     DrawBoundingBox(playerBox, RED);
                     
                     // Draw enemy bounding boxes
-                    for (int i = 0; i < enemyCount; i++) {
-                        if (enemies[i].active) {
-                            BoundingBox enemyBox = GetEnemyBoundingBox(enemies[i]);
-                            DrawBoundingBox(enemyBox, PURPLE);
-                        }
-                    }
-                    
-                    // Draw lines from player to surrounding cells to help visualize
-                    Vector3 playerCenter = {
-                        player.position.x,
-                        player.position.y + 0.5f,
-                        player.position.z
-                    };
-
-                    // Draw debug grid lines around player
-                    for (int z = -1; z <= 1; z++)
-                    {
-                        for (int x = -1; x <= 1; x++)
-                        {
-                            int currentCellX = (int)(player.position.x - mapPosition.x) + x;
-                            int currentCellZ = (int)(player.position.z - mapPosition.z) + z;
-                            
-                            // Skip cells outside the map bounds
-                            if (currentCellX < 0 || currentCellZ < 0 || 
-                                currentCellX >= cubicmap.width || currentCellZ >= cubicmap.height)
-                                continue;
-
-                            // Create a box for the current wall cell
-                            float cellXOffset = currentCellX - 0.5f;
-                            float cellZOffset = currentCellZ - 0.5f;
-                            BoundingBox cellBounds = {
-                                (Vector3){ mapPosition.x + cellXOffset, mapPosition.y, mapPosition.z + cellZOffset },
-                                (Vector3){ mapPosition.x + cellXOffset + 1.0f, mapPosition.y + 1.0f, mapPosition.z + cellZOffset + 1.0f }
-                            };
-                            DrawBoundingBox(cellBounds, GREEN);
-                            
-                            // Calculate center of cell
-                            Vector3 cellCenter = {
-                                mapPosition.x + cellXOffset + 0.5f,
-                                player.position.y,
-                                mapPosition.z + cellZOffset + 0.5f
-                            };
-                            
-                            // Draw line from player to cell center
-                            DrawLine3D(playerCenter, cellCenter, GREEN);
-
-                            
-                        }
+                    const Archetype *enemies = &world.archetypes[ARCHETYPE_ENEMY];
+                    for (int i = 0; i < enemies->count; i++) {
+                        BoundingBox enemyBox = GetEntityBoundingBox(enemies->transforms[i], enemies->colliders[i]);
+                        if (IsBoxInFrustum(&frustum, enemyBox)) DrawBoundingBox(enemyBox, PURPLE);
                     }
                 }
 
             EndMode3D();
+            EndProfileZone(PROFILE_DRAW_3D);
 
-            // Draw minimap
-            DrawTextureEx(cubicmap, (Vector2){ screenWidth - cubicmap.width*4.0f - 20, 20.0f }, 0.0f, 4.0f, WHITE);
-            DrawRectangleLines(screenWidth - cubicmap.width*4 - 20, 20, cubicmap.width*4, cubicmap.height*4, GREEN);
-            
-            // Draw player position on minimap - FIXED CALCULATION
-            float minimapScale = 4.0f;
-            int minimapX = screenWidth - cubicmap.width*minimapScale - 20;
-            int minimapY = 20;
-            
-            // Calculate the normalized position of the player within the map bounds
-            float normalizedX = (player.position.x - mapPosition.x) / mapWidth;  
-            float normalizedZ = (player.position.z - mapPosition.z) / mapHeight;
-            
-            // Convert to minimap coordinates
-            int playerMinimapX = minimapX + (int)(normalizedX * cubicmap.width * minimapScale);
-            int playerMinimapY = minimapY + (int)(normalizedZ * cubicmap.height * minimapScale);
-            
-            // Draw player on minimap
-            DrawRectangle(playerMinimapX, playerMinimapY, 4, 4, RED);
-            
-            // Draw enemies on minimap
-            for (int i = 0; i < enemyCount; i++) {
-                if (enemies[i].active) {
-                    float enemyNormalizedX = (enemies[i].position.x - mapPosition.x) / mapWidth;
-                    float enemyNormalizedZ = (enemies[i].position.z - mapPosition.z) / mapHeight;
-                    
-                    int enemyMinimapX = minimapX + (int)(enemyNormalizedX * cubicmap.width * minimapScale);
-                    int enemyMinimapY = minimapY + (int)(enemyNormalizedZ * cubicmap.height * minimapScale);
-                    
-                    DrawRectangle(enemyMinimapX, enemyMinimapY, 3, 3, PURPLE);
-                }
-            }
+            BeginProfileZone(PROFILE_HUD);
+
+            // Cached walls plus one quad run for the player and enemy markers
+            DrawMinimap(&minimap, &atlas, &world, mapPosition);
+
+            // Labels keep their glyph quads between frames, only changed values are formatted and laid out again
+            UpdateHudLayer(&hud, &atlas, &world, dungeon? dungeonFloor : 0, profiler.csvFile != NULL, screenWidth, screenHeight);
+            DrawHudLabels(&hud, &atlas, 0, HUD_LABEL_BANNER);
 
-            // Draw controls help
-            DrawText("Controls: WASD to move, SPACE to jump, Mouse wheel to zoom", 10, screenHeight - 70, 20, WHITE);
-            DrawText("Left-click to shoot, P to pause, F to toggle wireframe", 10, screenHeight - 50, 20, WHITE);
-            
             // Display player health
-            DrawText("HEALTH:", 10, 80, 20, WHITE);
-            DrawRectangle(100, 80, player.health, 20, (Color){ 255, (unsigned char)(player.health * 2.55f), 0, 255 });
-            DrawRectangleLines(100, 80, 100, 20, WHITE);
-            
-            // Display player position and physics for debugging
-            DrawText(TextFormat("Position: (%.2f, %.2f, %.2f)", player.position.x, player.position.y, player.position.z), 10, 30, 20, YELLOW);
-            DrawText(TextFormat("Velocity: (%.2f, %.2f, %.2f)", player.velocity.x, player.velocity.y, player.velocity.z), 10, 50, 20, YELLOW);
-            DrawFPS(10, 10);
+            int playerHealth = players->healths[0].health;
+            DrawRectangle(100, 80, playerHealth, 20, (Color){ 255, (unsigned char)(playerHealth * 2.55f), 0, 255 });
+            DrawRectangleLinesEx((Rectangle){ 100.0f, 80.0f, 100.0f, 20.0f }, 1.0f, WHITE);
 
             // Draw game state
-            if (gameState == GAME_PAUSED)
+            if (world.state != GAME_PLAYING)
             {
                 DrawRectangle(0, 0, screenWidth, screenHeight, Fade(BLACK, 0.6f));
-                
-                if (player.health <= 0) {
-                    DrawText("GAME OVER", screenWidth/2 - MeasureText("GAME OVER", 40)/2, screenHeight/2 - 40, 40, RED);
-                    DrawText("PRESS ESC TO QUIT", screenWidth/2 - MeasureText("PRESS ESC TO QUIT", 20)/2, screenHeight/2 + 10, 20, WHITE);
-                } else {
-                    DrawText("GAME PAUSED", screenWidth/2 - MeasureText("GAME PAUSED", 40)/2, screenHeight/2 - 40, 40, WHITE);
-                    DrawText("PRESS P TO RESUME", screenWidth/2 - MeasureText("PRESS P TO RESUME", 20)/2, screenHeight/2 + 10, 20, WHITE);
-                }
+                DrawHudLabels(&hud, &atlas, HUD_LABEL_BANNER, HUD_LABEL_COUNT);
             }
 
+            if (profiler.showOverlay) DrawProfilerOverlay(10, 110);
+
+            EndProfileZone(PROFILE_HUD);
+            EndProfileZone(PROFILE_FRAME);      // Excludes the buffer swap and frame rate wait in EndDrawing()
+            EndProfilerFrame();
+
         EndDrawing();
+
+        if (scenario != NULL)
+        {
+            benchFrameTimes[benchTick++] = (float)((GetProfilerTime() - frameStart)*1000.0);
+            if (benchTick >= benchTicks) break;
+        }
+        else if (replayTicked) replayFrameTimes[replayFrames++] = (float)((GetProfilerTime() - frameStart)*1000.0);
+    }
+
+    if (replayFile != NULL)
+    {
+        PrintBenchmarkReport(GetFileName(replayFile), "replay windowed", replayFrames, GetProfilerTime() - replayStart, replayFrameTimes);
+        printf("replay %s: %s after %d of %d ticks\n", GetFileName(replayFile), IsReplayInSync(&replay, &world)? "in sync" : "DIVERGED", replay.tick, replay.header.tickCount);
+        MemFree(replayFrameTimes);
+    }
+    else if (recordFile != NULL) SaveReplay(&replay, recordFile);
+    UnloadReplay(&replay);
+
+    if (scenario != NULL)
+    {
+        PrintBenchmarkReport(scenario->name, "windowed", benchTick, GetProfilerTime() - benchStart, benchFrameTimes);
+        MemFree(benchFrameTimes);
     }
 
+    StopProfilerCsv();
+
+    UnloadGameSnapshot(&checkpoint);
+    UnloadGameWorld(&world);
+    UnloadBulletRenderer(bulletRenderer);
+    UnloadMinimap(minimap);
     UnloadTexture(cubicmap);
+    CloseWorldStream(&worldStream);
+    UnloadMemoryArena(&levelArena);     // After the stream, its worker reads the grid
+    UnloadAssetBundle(bundle);      // Only the chunk meshes were still in use, by the stream
     UnloadTexture(texture);
-    UnloadModel(model);
-    UnloadTexture(player.texture);
-    UnloadTexture(enemyTexture);
+    SetShapesTexture((Texture2D){ 0 }, (Rectangle){ 0 });     // Back to raylib's own white texel
+    UnloadTextureAtlas(atlas);
+    UnloadMemoryArena(&frameArena);
+    
+    CloseJobSystem(&jobSystem);
     
     CloseWindow();
     return 0;
 }
 
-BoundingBox GetPlayerBoundingBox(Player player)
+// Set up the player and enemies for a new session
+void InitGameWorld(GameWorld *world, int enemyCount)
 {
-    return (BoundingBox){
-        (Vector3){ player.position.x - player.size.x/2, player.position.y, player.position.z - player.size.z/2 },
-        (Vector3){ player.position.x + player.size.x/2, player.position.y + player.size.y, player.position.z + player.size.z/2 }
-    };
+    memset(world, 0, sizeof(GameWorld));
+
+    // Entity storage, grown on demand so any wave size fits
+    InitArchetype(&world->archetypes[ARCHETYPE_PLAYER], ARCHETYPE_PLAYER_COMPONENTS, 1);
+    InitArchetype(&world->archetypes[ARCHETYPE_ENEMY], ARCHETYPE_ENEMY_COMPONENTS, (enemyCount > ENEMY_POOL_CAPACITY)? enemyCount : ENEMY_POOL_CAPACITY);
+    InitBulletPool(&world->bullets, BULLET_POOL_CAPACITY);
+
+    Archetype *players = &world->archetypes[ARCHETYPE_PLAYER];
+    int player = AddEntity(players);
+    players->transforms[player].position = (Vector3){ 0.0f, 0.5f, -2.0f };
+    players->transforms[player].previousPosition = players->transforms[player].position;
+    players->velocities[player].speed = 15.0f;
+    players->healths[player] = (HealthComponent){ 100, 100 };
+    players->hitFlashes[player].duration = 0.5f;
+    // Make player smaller to fit in 1-cube spaces
+    players->colliders[player].size = (Vector3){ 0.5f, 0.5f, 0.5f };
+    players->sprites[player] = (SpriteComponent){ SPRITE_PLAYER, false };
+    
+    // Initialize physics parameters (units per second)
+    players->controllers[player].isGrounded = true;
+    players->controllers[player].jumpForce = 12.0f;
+    players->controllers[player].gravity = 36.0f;
+    
+    // Initialize enemy positions randomly
+    Archetype *enemies = &world->archetypes[ARCHETYPE_ENEMY];
+    for (int i = 0; i < enemyCount; i++) {
+        int enemy = AddEntity(enemies);
+        enemies->transforms[enemy].position.x = GetRandomValue(0, 10) + 0.5f;
+        enemies->transforms[enemy].position.y = 0.5f;
+        enemies->transforms[enemy].position.z = GetRandomValue(0, 10) + 0.5f;
+        enemies->transforms[enemy].previousPosition = enemies->transforms[enemy].position;
+        enemies->velocities[enemy].speed = 7.8f; // Slower than player
+        enemies->healths[enemy] = (HealthComponent){ 30, 30 };
+        enemies->hitFlashes[enemy].duration = 0.2f; // Shorter invulnerability than player
+        enemies->colliders[enemy].size = (Vector3){ 0.5f, 0.5f, 0.5f };
+        enemies->sprites[enemy] = (SpriteComponent){ SPRITE_ENEMY, true };
+        enemies->shooters[enemy].shootTimer = GetRandomValue(0, 100) / 100.0f * ENEMY_SHOOT_COOLDOWN; // Randomize initial shoot timer
+        enemies->shooters[enemy].shootCooldown = ENEMY_SHOOT_COOLDOWN;
+    }
+    
+    world->canShoot = true;
+    world->shootTimer = 0.0f;
+    world->shootCooldown = 0.5f;
+    world->state = GAME_PLAYING;
 }
 
-BoundingBox GetEnemyBoundingBox(Enemy enemy)
+void UnloadGameWorld(GameWorld *world)
 {
-    return (BoundingBox){
-        (Vector3){ enemy.position.x - enemy.size.x/2, enemy.position.y, enemy.position.z - enemy.size.z/2 },
-        (Vector3){ enemy.position.x + enemy.size.x/2, enemy.position.y + enemy.size.y, enemy.position.z + enemy.size.z/2 }
-    };
+    for (int a = 0; a < ARCHETYPE_COUNT; a++) UnloadArchetype(&world->archetypes[a]);
+    UnloadBulletPool(&world->bullets);
 }
 
-// Updated to handle only horizontal and ground collisions
-bool CheckCollisionPlayerWithMap(Player *player, Model model, Vector3 mapPosition, Texture2D cubicmap)
+// Capture the world, the snapshot block only grows when the world has more in use than last time
+void SaveGameSnapshot(GameSnapshot *snapshot, const GameWorld *world)
 {
-    // First, check if player is within the overall map bounds
-    BoundingBox mapBounds = GetModelBoundingBox(model);
-    mapBounds.min = Vector3Add(mapBounds.min, mapPosition);
-    mapBounds.max = Vector3Add(mapBounds.max, mapPosition);
-    
-    // Get player bounding box
-    BoundingBox playerBounds = GetPlayerBoundingBox(*player);
-    
-    // Check if player is outside the map bounds
-    if (!CheckCollisionBoxes(playerBounds, mapBounds))
-        return true;
-        
-    // More precise collision detection with individual cubes
-    // Calculate the grid cell position where the player is currently located
-    int cellX = (int)(player->position.x - mapPosition.x);
-    int cellZ = (int)(player->position.z - mapPosition.z);
-    
-    // We need the image data to check pixel colors
-    Image cubicmapImage = LoadImageFromTexture(cubicmap);
-    
-    bool collision = false;
-    bool groundContact = false;
-    
-    // Check the surrounding cells for collisions (3x3 grid around player)
-    for (int z = -1; z <= 1; z++)
+    snapshot->world = *world;
+    snapshot->size = CopyGameWorldArrays((GameWorld *)world, world, NULL, false);
+
+    if (snapshot->size > snapshot->capacity)
     {
-        for (int x = -1; x <= 1; x++)
+        snapshot->capacity = snapshot->size;
+        snapshot->data = (unsigned char *)MemRealloc(snapshot->data, snapshot->capacity);
+    }
+
+    CopyGameWorldArrays((GameWorld *)world, world, snapshot->data, false);
+}
+
+// Put the world back the way it was, its storage is grown if it is smaller than the snapshot's but never shrunk
+// NOTE: Handles to entities added after the snapshot become stale
+void RestoreGameSnapshot(GameWorld *world, const GameSnapshot *snapshot)
+{
+    const GameWorld *saved = &snapshot->world;
+
+    for (int a = 0; a < ARCHETYPE_COUNT; a++)
+    {
+        Archetype *archetype = &world->archetypes[a];
+        if (archetype->capacity < saved->archetypes[a].capacity) GrowArchetype(archetype, saved->archetypes[a].capacity);
+    }
+    if (world->bullets.capacity < saved->bullets.capacity) GrowBulletPool(&world->bullets, saved->bullets.capacity);
+
+    CopyGameWorldArrays(world, saved, snapshot->data, true);
+
+    for (int a = 0; a < ARCHETYPE_COUNT; a++)
+    {
+        Archetype *archetype = &world->archetypes[a];
+        int capacity = archetype->capacity;
+        archetype->count = saved->archetypes[a].count;
+        archetype->freeSlot = saved->archetypes[a].freeSlot;
+
+        // Slots the world grew after the snapshot go back on the free list, bumped so no old handle matches them
+        for (int slot = capacity - 1; slot >= saved->archetypes[a].capacity; slot--)
         {
-            int currentCellX = cellX + x;
-            int currentCellZ = cellZ + z;
-            
-            // Skip cells outside the map bounds
-            if (currentCellX < 0 || currentCellZ < 0 || 
-                currentCellX >= cubicmap.width || currentCellZ >= cubicmap.height)
-                continue;
-            
-            // Check if the current cell is a wall (white pixel in the cubicmap)
-            Color cellColor = GetImageColor(cubicmapImage, currentCellX, currentCellZ);
-            
-            // If the cell is a wall (white or very light color)
-            if ((cellColor.r > 50) && (cellColor.g > 50) && (cellColor.b > 50))
-            {
-                // Create a box for the current wall cell
-                float cellXOffset = currentCellX - 0.5f;
-                float cellZOffset = currentCellZ - 0.5f;
-                BoundingBox cellBounds = {
-                    (Vector3){ mapPosition.x + cellXOffset, mapPosition.y, mapPosition.z + cellZOffset },
-                    (Vector3){ mapPosition.x + cellXOffset + 1.0f, mapPosition.y + 1.0f, mapPosition.z + cellZOffset + 1.0f }
-                };
-                
-                // Check collision between player and the current wall cell
-                if (CheckCollisionBoxes(playerBounds, cellBounds))
-                {
-                    // Check if this is a ground collision
-                    float playerBottomY = player->position.y;
-                    float cellTopY = mapPosition.y + 1.0f;
-                    
-                    if (fabs(playerBottomY - cellTopY) < 0.1f)
-                    {
-                        groundContact = true;
-                    }
-                    else
-                    {
-                        collision = true;
-                    }
-                }
-            }
+            archetype->slotGeneration[slot]++;
+            if (archetype->slotGeneration[slot] == 0) archetype->slotGeneration[slot] = 1;
+            archetype->slotDense[slot] = archetype->freeSlot;
+            archetype->freeSlot = slot;
         }
     }
-    
-    // Update player's grounded state based on ground contact
-    if (groundContact || player->position.y <= 0.5f)  // Also check if player is at the base height
+
+    world->bullets.count = saved->bullets.count;
+    world->canShoot = saved->canShoot;
+    world->shootTimer = saved->shootTimer;
+    world->shootCooldown = saved->shootCooldown;
+    world->state = saved->state;
+}
+
+void UnloadGameSnapshot(GameSnapshot *snapshot)
+{
+    MemFree(snapshot->data);
+    memset(snapshot, 0, sizeof(GameSnapshot));
+}
+
+// Copy the world's arrays to or from a packed block, always in the same order
+// Layout gives the counts and capacities, the entities in use and the whole slot tables are copied
+// Returns the block size, with data NULL nothing is copied
+int CopyGameWorldArrays(GameWorld *world, const GameWorld *layout, unsigned char *data, bool restore)
+{
+    int size = 0;
+
+    #define COPY_ARRAY(array, bytes) { \
+        if ((data != NULL) && restore) memcpy((array), data + size, (bytes)); \
+        else if (data != NULL) memcpy(data + size, (array), (bytes)); \
+        size += (int)(bytes); \
+    }
+    #define COPY_COMPONENT(array) if (archetype->array != NULL) COPY_ARRAY(archetype->array, count*sizeof(archetype->array[0]))
+
+    for (int a = 0; a < ARCHETYPE_COUNT; a++)
+    {
+        Archetype *archetype = &world->archetypes[a];
+        int count = layout->archetypes[a].count;
+        int capacity = layout->archetypes[a].capacity;
+
+        COPY_COMPONENT(transforms);
+        COPY_COMPONENT(velocities);
+        COPY_COMPONENT(healths);
+        COPY_COMPONENT(hitFlashes);
+        COPY_COMPONENT(colliders);
+        COPY_COMPONENT(sprites);
+        COPY_COMPONENT(controllers);
+        COPY_COMPONENT(shooters);
+        COPY_ARRAY(archetype->denseSlot, count*sizeof(int));
+        COPY_ARRAY(archetype->slotDense, capacity*sizeof(int));
+        COPY_ARRAY(archetype->slotGeneration, capacity*sizeof(unsigned int));
+    }
+
+    // The expired flags are the integration kernel's scratch
+    BulletPool *bullets = &world->bullets;
+    int count = layout->bullets.count;
+    COPY_ARRAY(bullets->positionX, count*sizeof(float));
+    COPY_ARRAY(bullets->positionY, count*sizeof(float));
+    COPY_ARRAY(bullets->positionZ, count*sizeof(float));
+    COPY_ARRAY(bullets->velocityX, count*sizeof(float));
+    COPY_ARRAY(bullets->velocityY, count*sizeof(float));
+    COPY_ARRAY(bullets->velocityZ, count*sizeof(float));
+    COPY_ARRAY(bullets->previousX, count*sizeof(float));
+    COPY_ARRAY(bullets->previousY, count*sizeof(float));
+    COPY_ARRAY(bullets->previousZ, count*sizeof(float));
+    COPY_ARRAY(bullets->radius, count*sizeof(float));
+    COPY_ARRAY(bullets->fromPlayer, count*sizeof(bool));
+
+    #undef COPY_COMPONENT
+    #undef COPY_ARRAY
+
+    return size;
+}
+
+void InitArchetype(Archetype *archetype, unsigned int components, int capacity)
+{
+    memset(archetype, 0, sizeof(Archetype));
+    archetype->components = components;
+    archetype->freeSlot = -1;
+    GrowArchetype(archetype, capacity);
+}
+
+void UnloadArchetype(Archetype *archetype)
+{
+    MemFree(archetype->transforms);
+    MemFree(archetype->velocities);
+    MemFree(archetype->healths);
+    MemFree(archetype->hitFlashes);
+    MemFree(archetype->colliders);
+    MemFree(archetype->sprites);
+    MemFree(archetype->controllers);
+    MemFree(archetype->shooters);
+    MemFree(archetype->denseSlot);
+    MemFree(archetype->slotDense);
+    MemFree(archetype->slotGeneration);
+    memset(archetype, 0, sizeof(Archetype));
+}
+
+// Resize the component arrays the archetype has and its slot table, the new slots go on the free list
+void GrowArchetype(Archetype *archetype, int capacity)
+{
+    // Only the components in the mask get storage
+    #define GROW_COMPONENT(flag, array, type) \
+        if (archetype->components & (flag)) archetype->array = (type *)MemRealloc(archetype->array, capacity*sizeof(type))
+
+    GROW_COMPONENT(COMPONENT_TRANSFORM, transforms, TransformComponent);
+    GROW_COMPONENT(COMPONENT_VELOCITY, velocities, VelocityComponent);
+    GROW_COMPONENT(COMPONENT_HEALTH, healths, HealthComponent);
+    GROW_COMPONENT(COMPONENT_HIT_FLASH, hitFlashes, HitFlashComponent);
+    GROW_COMPONENT(COMPONENT_COLLIDER, colliders, ColliderComponent);
+    GROW_COMPONENT(COMPONENT_SPRITE, sprites, SpriteComponent);
+    GROW_COMPONENT(COMPONENT_CONTROLLER, controllers, ControllerComponent);
+    GROW_COMPONENT(COMPONENT_SHOOTER, shooters, ShooterComponent);
+
+    #undef GROW_COMPONENT
+
+    archetype->denseSlot = (int *)MemRealloc(archetype->denseSlot, capacity*sizeof(int));
+    archetype->slotDense = (int *)MemRealloc(archetype->slotDense, capacity*sizeof(int));
+    archetype->slotGeneration = (unsigned int *)MemRealloc(archetype->slotGeneration, capacity*sizeof(unsigned int));
+
+    // Pushed in reverse so the lowest new slot is handed out first
+    for (int slot = capacity - 1; slot >= archetype->capacity; slot--)
+    {
+        archetype->slotGeneration[slot] = 1;
+        archetype->slotDense[slot] = archetype->freeSlot;
+        archetype->freeSlot = slot;
+    }
+
+    archetype->capacity = capacity;
+}
+
+bool HasComponents(const Archetype *archetype, unsigned int components)
+{
+    return ((archetype->components & components) == components);
+}
+
+// Append a zeroed entity to the live range, growing the archetype when it's full
+// Returns its dense index, valid until the next removal
+int AddEntity(Archetype *archetype)
+{
+    if (archetype->count >= archetype->capacity) GrowArchetype(archetype, (archetype->capacity > 0)? archetype->capacity*2 : ENEMY_POOL_CAPACITY);
+
+    int slot = archetype->freeSlot;
+    archetype->freeSlot = archetype->slotDense[slot];
+
+    int index = archetype->count++;
+    archetype->denseSlot[index] = slot;
+    archetype->slotDense[slot] = index;
+
+    #define CLEAR_COMPONENT(array) if (archetype->array != NULL) memset(&archetype->array[index], 0, sizeof(archetype->array[0]))
+
+    CLEAR_COMPONENT(transforms);
+    CLEAR_COMPONENT(velocities);
+    CLEAR_COMPONENT(healths);
+    CLEAR_COMPONENT(hitFlashes);
+    CLEAR_COMPONENT(colliders);
+    CLEAR_COMPONENT(sprites);
+    CLEAR_COMPONENT(controllers);
+    CLEAR_COMPONENT(shooters);
+
+    #undef CLEAR_COMPONENT
+
+    return index;
+}
+
+// Remove a live entity, the last live entity is moved into its place
+// NOTE: Callers iterating the archetype must revisit index after removing, handles to the removed entity go stale
+void RemoveEntity(Archetype *archetype, int index)
+{
+    int slot = archetype->denseSlot[index];
+    int last = --archetype->count;
+
+    #define MOVE_COMPONENT(array) if (archetype->array != NULL) archetype->array[index] = archetype->array[last]
+
+    MOVE_COMPONENT(transforms);
+    MOVE_COMPONENT(velocities);
+    MOVE_COMPONENT(healths);
+    MOVE_COMPONENT(hitFlashes);
+    MOVE_COMPONENT(colliders);
+    MOVE_COMPONENT(sprites);
+    MOVE_COMPONENT(controllers);
+    MOVE_COMPONENT(shooters);
+
+    #undef MOVE_COMPONENT
+
+    archetype->denseSlot[index] = archetype->denseSlot[last];
+    archetype->slotDense[archetype->denseSlot[index]] = index;
+
+    archetype->slotGeneration[slot]++;
+    if (archetype->slotGeneration[slot] == 0) archetype->slotGeneration[slot] = 1;
+    archetype->slotDense[slot] = archetype->freeSlot;
+    archetype->freeSlot = slot;
+}
+
+// Drop entities killed this tick, done once after collisions so indices stay stable during the tick
+void RemoveDeadEntities(Archetype *archetype)
+{
+    if (!HasComponents(archetype, COMPONENT_HEALTH)) return;
+
+    // Walk backwards so the entity swapped into a freed place has already been checked
+    for (int i = archetype->count - 1; i >= 0; i--)
+    {
+        if (archetype->healths[i].health <= 0) RemoveEntity(archetype, i);
+    }
+}
+
+EntityHandle GetEntityHandle(const GameWorld *world, int archetype, int index)
+{
+    int slot = world->archetypes[archetype].denseSlot[index];
+    return (EntityHandle){ archetype, slot, world->archetypes[archetype].slotGeneration[slot] };
+}
+
+// Resolve a handle to its current dense index, -1 once its entity has been removed
+int GetEntityIndex(const GameWorld *world, EntityHandle handle)
+{
+    if ((handle.archetype < 0) || (handle.archetype >= ARCHETYPE_COUNT)) return -1;
+
+    const Archetype *archetype = &world->archetypes[handle.archetype];
+    if ((handle.slot < 0) || (handle.slot >= archetype->capacity)) return -1;
+    if (archetype->slotGeneration[handle.slot] != handle.generation) return -1;
+
+    return archetype->slotDense[handle.slot];
+}
+
+// Move the player onto a floor's spawn cell and scatter enemies over open cells away from it
+// NOTE: Uses raylib's random stream, so a seeded session places enemies the same way every run
+void PlaceGameWorld(GameWorld *world, const MapCollision *map, int spawnX, int spawnZ)
+{
+    TransformComponent *player = &world->archetypes[ARCHETYPE_PLAYER].transforms[0];
+    player->position = (Vector3){ map->position.x + spawnX, 0.5f, map->position.z + spawnZ };
+    player->previousPosition = player->position;
+
+    Archetype *enemies = &world->archetypes[ARCHETYPE_ENEMY];
+    for (int i = 0; i < enemies->count; i++)
+    {
+        int cellX = spawnX;
+        int cellZ = spawnZ;
+
+        // Random open cell, small floors fall back to the last open cell found at any distance
+        for (int attempt = 0; attempt < 100; attempt++)
+        {
+            int x = GetRandomValue(0, map->grid.width - 1);
+            int z = GetRandomValue(0, map->grid.height - 1);
+            if (IsCollisionGridWall(&map->grid, x, z)) continue;
+
+            cellX = x;
+            cellZ = z;
+            if (abs(x - spawnX) + abs(z - spawnZ) >= DUNGEON_ENEMY_DISTANCE) break;
+        }
+
+        enemies->transforms[i].position = (Vector3){ map->position.x + cellX, 0.5f, map->position.z + cellZ };
+        enemies->transforms[i].previousPosition = enemies->transforms[i].position;
+    }
+}
+
+// Advance the simulation by one fixed tick
+// Every stage is a system over the archetypes holding the components it needs
+void UpdateGameWorld(GameWorld *world, const GameInput *input, const MapCollision *map, SpatialGrid *enemyGrid, FlowField *flowField, VisibilityGrid *visibility)
+{
+    Archetype *players = &world->archetypes[ARCHETYPE_PLAYER];
+    Archetype *enemies = &world->archetypes[ARCHETYPE_ENEMY];
+
+    // Keep last tick's positions for render interpolation
+    UpdateTransformHistory(world);
+    UpdateHitFlashes(world, SIMULATION_TICK_TIME);
+
+    // Input sets the player's velocity and fires the player's bullets
+    UpdatePlayerControl(world, input);
+
+    // Enemies steer and aim at where the player is at the start of the tick
+    BeginProfileZone(PROFILE_ENEMIES);
+    UpdateFlowField(flowField, map, players->transforms[0].position);
+    UpdateVisibilityGrid(visibility, map, players->transforms[0].position);
+    UpdateEnemyAI(world, map, flowField, visibility, SIMULATION_TICK_TIME);
+    EndProfileZone(PROFILE_ENEMIES);
+
+    // Move everything with a velocity against the map, then gravity and jumping
+    BeginProfileZone(PROFILE_MOVEMENT);
+    UpdateMovement(world, map, SIMULATION_TICK_TIME);
+    UpdateGravity(world, map, SIMULATION_TICK_TIME);
+    EndProfileZone(PROFILE_MOVEMENT);
+
+    // Update bullets
+    BeginProfileZone(PROFILE_BULLETS);
+    UpdateBullets(&world->bullets, SIMULATION_TICK_TIME);
+    EndProfileZone(PROFILE_BULLETS);
+
+    // Bucket enemies at their new positions, counted as part of the collision stage
+    BeginProfileZone(PROFILE_BULLET_COLLISIONS);
+    BuildSpatialGrid(enemyGrid, map, enemies->transforms, enemies->count);
+
+    // Check bullet collisions
+    CheckBulletCollisions(&world->bullets, players, enemies, map, enemyGrid);
+
+    // Killed enemies leave their archetype now that nothing holds their indices
+    RemoveDeadEntities(enemies);
+    EndProfileZone(PROFILE_BULLET_COLLISIONS);
+
+    // Check game over condition
+    if (players->healths[0].health <= 0) world->state = GAME_OVER;
+}
+
+// Store every position before the tick moves anything
+void UpdateTransformHistory(GameWorld *world)
+{
+    for (int a = 0; a < ARCHETYPE_COUNT; a++)
+    {
+        Archetype *archetype = &world->archetypes[a];
+        if (!HasComponents(archetype, COMPONENT_TRANSFORM)) continue;
+
+        for (int i = 0; i < archetype->count; i++) archetype->transforms[i].previousPosition = archetype->transforms[i].position;
+    }
+}
+
+// Count down hit flashes, the entity can be damaged again once its flash is over
+void UpdateHitFlashes(GameWorld *world, float deltaTime)
+{
+    for (int a = 0; a < ARCHETYPE_COUNT; a++)
+    {
+        Archetype *archetype = &world->archetypes[a];
+        if (!HasComponents(archetype, COMPONENT_HIT_FLASH)) continue;
+
+        for (int i = 0; i < archetype->count; i++)
+        {
+            HitFlashComponent *hitFlash = &archetype->hitFlashes[i];
+            if (hitFlash->isHit)
+            {
+                hitFlash->hitTimer -= deltaTime;
+                if (hitFlash->hitTimer <= 0.0f) hitFlash->isHit = false;
+            }
+        }
+    }
+}
+
+// Turn the tick's input into the player's velocity, facing and jump request, and handle player shooting
+void UpdatePlayerControl(GameWorld *world, const GameInput *input)
+{
+    Archetype *players = &world->archetypes[ARCHETYPE_PLAYER];
+    if (players->count == 0) return;
+
+    Vector3 position = players->transforms[0].position;
+    VelocityComponent *velocity = &players->velocities[0];
+    ControllerComponent *controller = &players->controllers[0];
+
+    // Player horizontal movement (no vertical movement here)
+    velocity->velocity.x = 0.0f;
+    velocity->velocity.z = 0.0f;
+
+    if (input->moveRight)
+    {
+        velocity->velocity.x = velocity->speed;
+        controller->direction = 1;
+    }
+    else if (input->moveLeft)
+    {
+        velocity->velocity.x = -velocity->speed;
+        controller->direction = 3;
+    }
+
+    if (input->moveDown)
+    {
+        velocity->velocity.z = velocity->speed;
+        controller->direction = 0;
+    }
+    else if (input->moveUp)
+    {
+        velocity->velocity.z = -velocity->speed;
+        controller->direction = 2;
+    }
+
+    // Jumping is applied by the gravity step - can always jump regardless of space constraints
+    if (input->jump) controller->jumpRequested = true;
+
+    // Player shooting
+    if (!world->canShoot) {
+        world->shootTimer -= SIMULATION_TICK_TIME;
+        if (world->shootTimer <= 0.0f) {
+            world->canShoot = true;
+        }
+    }
+
+    if (input->shoot && world->canShoot) {
+        // Mouse position in 3D world space, captured when the button was pressed
+        Ray ray = input->shootRay;
+    
+        // Project the mouse ray onto the same y-plane as the player + 0.5f
+        float t = ((position.y + 0.5f) - ray.position.y) / ray.direction.y;
+        Vector3 targetPoint = Vector3Add(ray.position, Vector3Scale(ray.direction, t));
+    
+        // Calculate the direction vector from player to the projected point
+        Vector3 direction = Vector3Normalize(Vector3Subtract(
+            targetPoint,
+            (Vector3){ position.x, position.y + 0.5f, position.z }));
+    
+        // Force the y component to be zero to ensure horizontal shooting
+        direction.y = 0.0f;
+    
+        // Re-normalize after zeroing the y component
+        direction = Vector3Normalize(direction);
+    
+        // Shoot bullet
+        ShootBullet(&world->bullets, 
+            (Vector3){ position.x, position.y + 0.5f, position.z }, 
+            direction, true);
+    
+        world->canShoot = false;
+        world->shootTimer = world->shootCooldown;
+    }
+}
+
+// Simulate sessions without a window, driven by the seeded input bot
+// Only image data is loaded, nothing touches the GPU
+int RunHeadless(int sessions, int ticks, unsigned int seed)
+{
+    // Same grid source as the windowed game, only the cells are kept from the bundle
+    AssetBundle bundle = LoadAssetBundle(ASSET_BUNDLE_FILE);
+    Vector3 mapPosition = { -16.0f, 0.0f, -8.0f };
+    MapCollision mapCollision = LoadLevelMapCollision(&bundle, mapPosition);
+    UnloadAssetBundle(bundle);
+    if (mapCollision.grid.cells == NULL) return 1;
+
+    SpatialGrid enemyGrid = LoadSpatialGrid(&mapCollision, ENEMY_POOL_CAPACITY);
+    FlowField flowField = LoadFlowField(&mapCollision);
+    VisibilityGrid visibility = LoadVisibilityGrid(&mapCollision);
+
+    GameWorld *world = (GameWorld *)MemAlloc(sizeof(GameWorld));
+    long totalTicks = 0;
+    clock_t start = clock();
+
+    for (int session = 0; session < sessions; session++)
+    {
+        unsigned int sessionSeed = seed + session;
+        SetRandomSeed(sessionSeed);
+        InitGameWorld(world, 10);
+
+        InputBot bot = { 0 };
+        InitInputBot(&bot, sessionSeed);
+
+        int tick = 0;
+        for (; (tick < ticks) && (world->state == GAME_PLAYING); tick++)
+        {
+            ResetMemoryArena(&frameArena);      // Every tick is a frame here
+
+            GameInput input = UpdateInputBot(&bot, world);
+            UpdateGameWorld(world, &input, &mapCollision, &enemyGrid, &flowField, &visibility);
+        }
+        totalTicks += tick;
+
+        printf("session %d: seed %u, %d ticks, health %d, enemies left %d/%d, bullets %d\n",
+            session, sessionSeed, tick, world->archetypes[ARCHETYPE_PLAYER].healths[0].health, world->archetypes[ARCHETYPE_ENEMY].count, 10, world->bullets.count);
+
+        UnloadGameWorld(world);
+    }
+
+    double seconds = (double)(clock() - start)/CLOCKS_PER_SEC;
+    printf("%ld ticks in %.3f s (%.0f ticks/s)\n", totalTicks, seconds, (seconds > 0.0)? totalTicks/seconds : 0.0);
+
+    MemFree(world);
+    UnloadMemoryArena(&levelArena);     // Map, grids and fields all go at once
+    UnloadMemoryArena(&frameArena);
+
+    return 0;
+}
+
+void InitInputBot(InputBot *bot, unsigned int seed)
+{
+    bot->rngState = (seed != 0)? seed : 1;     // Xorshift state must be non-zero
+    bot->moveX = 0;
+    bot->moveZ = 0;
+    bot->retargetTicks = 0;
+    bot->target = (EntityHandle){ 0 };
+}
+
+// Generate this tick's input: wander in random directions and shoot at the nearest enemy in range
+GameInput UpdateInputBot(InputBot *bot, const GameWorld *world)
+{
+    GameInput input = { 0 };
+    Vector3 player = world->archetypes[ARCHETYPE_PLAYER].transforms[0].position;
+    const Archetype *enemies = &world->archetypes[ARCHETYPE_ENEMY];
+
+    // Xorshift32
+    #define BOT_RANDOM() (bot->rngState ^= bot->rngState << 13, bot->rngState ^= bot->rngState >> 17, bot->rngState ^= bot->rngState << 5)
+
+    if (bot->retargetTicks <= 0)
+    {
+        bot->moveX = (int)(BOT_RANDOM()%3) - 1;
+        bot->moveZ = (int)(BOT_RANDOM()%3) - 1;
+        bot->retargetTicks = 15 + (int)(BOT_RANDOM()%45);
+    }
+    bot->retargetTicks--;
+
+    input.moveRight = (bot->moveX > 0);
+    input.moveLeft = (bot->moveX < 0);
+    input.moveDown = (bot->moveZ > 0);
+    input.moveUp = (bot->moveZ < 0);
+    input.jump = (BOT_RANDOM()%120 == 0);
+
+    // Keep shooting the same enemy until it dies or gets away, then aim at the nearest one in range
+    const float range = 12.0f;
+    int target = GetEntityIndex(world, bot->target);
+    if ((target < 0) || (Vector3DistanceSqr(enemies->transforms[target].position, player) >= range*range))
+    {
+        target = -1;
+        float targetDistanceSqr = range*range;
+        for (int i = 0; i < enemies->count; i++)
+        {
+            float distanceSqr = Vector3DistanceSqr(enemies->transforms[i].position, player);
+            if (distanceSqr < targetDistanceSqr)
+            {
+                target = i;
+                targetDistanceSqr = distanceSqr;
+                bot->target = GetEntityHandle(world, ARCHETYPE_ENEMY, i);
+            }
+        }
+    }
+
+    if (target >= 0)
+    {
+        // Straight down onto the enemy, the tick projects the ray onto the shooting plane
+        Vector3 aim = enemies->transforms[target].position;
+        input.shoot = true;
+        input.shootRay = (Ray){ (Vector3){ aim.x, player.y + 10.0f, aim.z }, (Vector3){ 0.0f, -1.0f, 0.0f } };
+    }
+
+    #undef BOT_RANDOM
+
+    return input;
+}
+
+// Collider box standing on the transform's position
+BoundingBox GetEntityBoundingBox(TransformComponent transform, ColliderComponent collider)
+{
+    Vector3 position = transform.position;
+    Vector3 size = collider.size;
+
+    return (BoundingBox){
+        (Vector3){ position.x - size.x/2, position.y, position.z - size.z/2 },
+        (Vector3){ position.x + size.x/2, position.y + size.y, position.z + size.z/2 }
+    };
+}
+
+// Time of impact of a box moving by step against a static box, on the XZ plane
+// Returns false if they don't meet within the step, axis is 0 for an x face and 2 for a z face
+// NOTE: Boxes overlapping at the start are ignored so anything stuck in a wall can walk out of it
+bool GetSweepHit(BoundingBox box, Vector3 step, BoundingBox obstacle, float *time, int *axis)
+{
+    float entryX = -INFINITY;
+    float exitX = INFINITY;
+    float entryZ = -INFINITY;
+    float exitZ = INFINITY;
+
+    if (step.x > 0.0f)
+    {
+        entryX = (obstacle.min.x - box.max.x)/step.x;
+        exitX = (obstacle.max.x - box.min.x)/step.x;
+    }
+    else if (step.x < 0.0f)
+    {
+        entryX = (obstacle.max.x - box.min.x)/step.x;
+        exitX = (obstacle.min.x - box.max.x)/step.x;
+    }
+    else if ((box.max.x <= obstacle.min.x) || (box.min.x >= obstacle.max.x)) return false;
+
+    if (step.z > 0.0f)
+    {
+        entryZ = (obstacle.min.z - box.max.z)/step.z;
+        exitZ = (obstacle.max.z - box.min.z)/step.z;
+    }
+    else if (step.z < 0.0f)
+    {
+        entryZ = (obstacle.max.z - box.min.z)/step.z;
+        exitZ = (obstacle.min.z - box.max.z)/step.z;
+    }
+    else if ((box.max.z <= obstacle.min.z) || (box.min.z >= obstacle.max.z)) return false;
+
+    float entry = fmaxf(entryX, entryZ);
+    float exit = fminf(exitX, exitZ);
+    if ((entry > exit) || (entry < 0.0f) || (entry >= 1.0f)) return false;
+
+    *time = entry;
+    *axis = (entryX > entryZ)? 0 : 2;
+    return true;
+}
+
+// Move a box by step on the XZ plane, stopping at walls and sliding along them
+// Only the cells covered by the swept box are tested, so fast movers can't tunnel through thin walls
+// A wall whose top is within 0.1 below the box is ground, not an obstacle, cells outside the map always block
+// Returns the displacement actually made
+Vector3 SweepBoxWithMap(BoundingBox box, Vector3 step, const MapCollision *map)
+{
+    Vector3 moved = { 0.0f, 0.0f, 0.0f };
+    Vector3 remaining = { step.x, 0.0f, step.z };
+
+    // Nothing to hit when the nearest wall is further than the box reaches over the whole step
+    Vector3 center = Vector3Scale(Vector3Add(box.min, box.max), 0.5f);
+    float reach = 0.5f*sqrtf((box.max.x - box.min.x)*(box.max.x - box.min.x) + (box.max.z - box.min.z)*(box.max.z - box.min.z));
+    if (GetMapClearance(map, center) > reach + sqrtf(step.x*step.x + step.z*step.z)) return remaining;
+
+    for (int iteration = 0; (iteration < SWEEP_ITERATIONS) && ((remaining.x != 0.0f) || (remaining.z != 0.0f)); iteration++)
+    {
+        // Cells under the box over the whole remaining step
+        int minX, minZ, maxX, maxZ;
+        GetMapCell(map, (Vector3){ fminf(box.min.x, box.min.x + remaining.x), 0.0f, fminf(box.min.z, box.min.z + remaining.z) }, &minX, &minZ);
+        GetMapCell(map, (Vector3){ fmaxf(box.max.x, box.max.x + remaining.x), 0.0f, fmaxf(box.max.z, box.max.z + remaining.z) }, &maxX, &maxZ);
+
+        float hitTime = 1.0f;
+        int hitAxis = -1;
+        BoundingBox hitBox = { 0 };
+
+        for (int z = minZ; z <= maxZ; z++)
+        {
+            for (int x = minX; x <= maxX; x++)
+            {
+                bool outside = (x < 0) || (x >= map->grid.width) || (z < 0) || (z >= map->grid.height);
+                if (!outside && !IsCollisionGridWall(&map->grid, x, z)) continue;
+
+                // Walls only block boxes beside them, not the ones standing on top
+                BoundingBox cellBounds = GetMapCellBox(map, x, z);
+                if (!outside && ((box.max.y <= cellBounds.min.y) || (box.min.y > cellBounds.max.y - 0.1f))) continue;
+
+                float time = 0.0f;
+                int axis = 0;
+                if (GetSweepHit(box, remaining, cellBounds, &time, &axis) && (time < hitTime))
+                {
+                    hitTime = time;
+                    hitAxis = axis;
+                    hitBox = cellBounds;
+                }
+            }
+        }
+
+        Vector3 offset = remaining;
+        if (hitAxis == 0)
+        {
+            // Stop a skin short of the wall, the rest of the step slides along it
+            offset.x = (remaining.x > 0.0f)? fmaxf(hitBox.min.x - SWEEP_SKIN - box.max.x, 0.0f) : fminf(hitBox.max.x + SWEEP_SKIN - box.min.x, 0.0f);
+            offset.z = remaining.z*hitTime;
+        }
+        else if (hitAxis == 2)
+        {
+            offset.x = remaining.x*hitTime;
+            offset.z = (remaining.z > 0.0f)? fmaxf(hitBox.min.z - SWEEP_SKIN - box.max.z, 0.0f) : fminf(hitBox.max.z + SWEEP_SKIN - box.min.z, 0.0f);
+        }
+
+        box.min = Vector3Add(box.min, offset);
+        box.max = Vector3Add(box.max, offset);
+        moved = Vector3Add(moved, offset);
+
+        if (hitAxis < 0) break;
+        else if (hitAxis == 0)
+        {
+            remaining.x = 0.0f;
+            remaining.z -= offset.z;
+        }
+        else
+        {
+            remaining.x -= offset.x;
+            remaining.z = 0.0f;
+        }
+    }
+
+    return moved;
+}
+
+// Check if the box rests on a wall top, its bottom within 0.1 of it
+bool CheckGroundContactWithMap(BoundingBox box, const MapCollision *map)
+{
+    // No wall under a box that fits in the clearance around its centre
+    Vector3 center = Vector3Scale(Vector3Add(box.min, box.max), 0.5f);
+    float reach = 0.5f*sqrtf((box.max.x - box.min.x)*(box.max.x - box.min.x) + (box.max.z - box.min.z)*(box.max.z - box.min.z));
+    if (GetMapClearance(map, center) > reach) return false;
+
+    int minX, minZ, maxX, maxZ;
+    GetMapCell(map, box.min, &minX, &minZ);
+    GetMapCell(map, box.max, &maxX, &maxZ);
+
+    for (int z = minZ; z <= maxZ; z++)
+    {
+        for (int x = minX; x <= maxX; x++)
+        {
+            // Only wall cells can be stood on (cells outside the map count as open)
+            BoundingBox cellBounds = { 0 };
+            if (GetMapWallBox(map, x, z, &cellBounds) && CheckCollisionBoxes(box, cellBounds) &&
+                (fabsf(box.min.y - cellBounds.max.y) < 0.1f)) return true;
+        }
+    }
+
+    return false;
+}
+
+// Take damage unless still flashing from the last hit
+// Returns true if the damage was applied
+bool ApplyDamage(HealthComponent *health, HitFlashComponent *hitFlash, int damage)
+{
+    if (hitFlash->isHit) return false;
+
+    health->health -= damage;
+    hitFlash->isHit = true;
+    hitFlash->hitTimer = hitFlash->duration; // Invulnerability period
+
+    return true;
+}
+
+// Check if a bullet hits the map anywhere between its last and current position
+// Walks the grid cells the segment crosses (DDA), testing only walls the bullet passes within radius of
+// NOTE: Walls are tested inflated by the radius, cells outside the map count as solid so leaving bullets despawn
+bool CheckCollisionBulletPathWithMap(Vector3 start, Vector3 end, float radius, const MapCollision *map)
+{
+    Vector3 delta = Vector3Subtract(end, start);
+
+    // Most bullets are nowhere near a wall, the whole segment stays within its length of the start
+    if (GetMapClearance(map, start) > Vector3Length(delta) + radius) return false;
+
+    GridMarch march = InitGridMarch(map, start, end);
+    while (NextGridMarchCell(&march))
+    {
+        if (CheckCollisionBulletSpan(start, delta, march.enter, march.leave, radius, map)) return true;
+    }
+
+    return false;
+}
+
+// Test the part of a bullet segment inside one cell against the walls within radius of it
+bool CheckCollisionBulletSpan(Vector3 start, Vector3 delta, float enter, float leave, float radius, const MapCollision *map)
+{
+    Vector3 spanStart = Vector3Add(start, Vector3Scale(delta, enter));
+    Vector3 spanEnd = Vector3Add(start, Vector3Scale(delta, leave));
+
+    int minX, minZ, maxX, maxZ;
+    GetMapCell(map, (Vector3){ fminf(spanStart.x, spanEnd.x) - radius, 0.0f, fminf(spanStart.z, spanEnd.z) - radius }, &minX, &minZ);
+    GetMapCell(map, (Vector3){ fmaxf(spanStart.x, spanEnd.x) + radius, 0.0f, fmaxf(spanStart.z, spanEnd.z) + radius }, &maxX, &maxZ);
+
+    for (int z = minZ; z <= maxZ; z++)
+    {
+        for (int x = minX; x <= maxX; x++)
+        {
+            // Within radius of the map edge
+            if ((x < 0) || (x >= map->grid.width) || (z < 0) || (z >= map->grid.height)) return true;
+            if (!IsCollisionGridWall(&map->grid, x, z)) continue;
+
+            BoundingBox cellBounds = GetMapCellBox(map, x, z);
+            Vector3 inflate = { radius, radius, radius };
+            cellBounds.min = Vector3Subtract(cellBounds.min, inflate);
+            cellBounds.max = Vector3Add(cellBounds.max, inflate);
+            if (CheckCollisionSegmentBox(spanStart, spanEnd, cellBounds)) return true;
+        }
+    }
+
+    return false;
+}
+
+// Slab test, true if any part of the segment is inside the box
+bool CheckCollisionSegmentBox(Vector3 start, Vector3 end, BoundingBox box)
+{
+    float origin[3] = { start.x, start.y, start.z };
+    float delta[3] = { end.x - start.x, end.y - start.y, end.z - start.z };
+    float boxMin[3] = { box.min.x, box.min.y, box.min.z };
+    float boxMax[3] = { box.max.x, box.max.y, box.max.z };
+    float enter = 0.0f;
+    float leave = 1.0f;
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (delta[axis] == 0.0f)
+        {
+            // Parallel to this slab, inside it or never
+            if ((origin[axis] < boxMin[axis]) || (origin[axis] > boxMax[axis])) return false;
+            continue;
+        }
+
+        float t0 = (boxMin[axis] - origin[axis])/delta[axis];
+        float t1 = (boxMax[axis] - origin[axis])/delta[axis];
+        enter = fmaxf(enter, fminf(t0, t1));
+        leave = fminf(leave, fmaxf(t0, t1));
+        if (enter > leave) return false;
+    }
+
+    return true;
+}
+
+// Check collision between a sphere and a box
+// Returns true if the sphere and box collide, false otherwise
+bool CheckCollisionSphereBox(Vector3 center, float radius, BoundingBox box)
+{
+    // Find the closest point to the sphere within the box
+    Vector3 closest = {
+        fmaxf(box.min.x, fminf(center.x, box.max.x)),
+        fmaxf(box.min.y, fminf(center.y, box.max.y)),
+        fmaxf(box.min.z, fminf(center.z, box.max.z))
+    };
+    
+    // Calculate the distance between the sphere's center and the closest point
+    Vector3 offset = Vector3Subtract(closest, center);
+    float distanceSquared = offset.x*offset.x + offset.y*offset.y + offset.z*offset.z;
+    
+    // If the distance is less than the radius squared, they collide
+    return distanceSquared < (radius * radius);
+}
+
+// Gravity, jumping and vertical movement of every controlled entity
+void UpdateGravity(GameWorld *world, const MapCollision *map, float deltaTime)
+{
+    for (int a = 0; a < ARCHETYPE_COUNT; a++)
+    {
+        Archetype *archetype = &world->archetypes[a];
+        if (!HasComponents(archetype, COMPONENT_TRANSFORM | COMPONENT_VELOCITY | COMPONENT_COLLIDER | COMPONENT_CONTROLLER)) continue;
+
+        for (int i = 0; i < archetype->count; i++)
+        {
+            TransformComponent *transform = &archetype->transforms[i];
+            Vector3 *velocity = &archetype->velocities[i].velocity;
+            ControllerComponent *controller = &archetype->controllers[i];
+
+            // Handle jumping, grounded was refreshed by the movement step
+            if (controller->jumpRequested && controller->isGrounded)
+            {
+                velocity->y = controller->jumpForce;
+                controller->isGrounded = false;
+            }
+            controller->jumpRequested = false;
+
+            // Apply gravity
+            if (!controller->isGrounded)
+            {
+                velocity->y -= controller->gravity*deltaTime;
+            }
+            else if (velocity->y < 0)
+            {
+                // Reset vertical velocity when grounded
+                velocity->y = 0;
+            }
+            
+            // Apply vertical velocity to position
+            transform->position.y += velocity->y*deltaTime;
+            
+            // Check if below ground level
+            if (transform->position.y < 0.5f)  // Assuming 0.5f is ground level
+            {
+                transform->position.y = 0.5f;
+                velocity->y = 0;
+                controller->isGrounded = true;
+                continue;
+            }
+
+            controller->isGrounded = false;  // Assume not grounded until proven otherwise
+            
+            // Only check for ground collisions, not ceiling collisions
+            if (velocity->y >= 0) continue;  // Only when falling
+
+            // Check if we've landed on ground
+            BoundingBox bounds = GetEntityBoundingBox(*transform, archetype->colliders[i]);
+            
+            // Calculate the grid cell position where the entity is currently located
+            int cellX, cellZ;
+            GetMapCell(map, transform->position, &cellX, &cellZ);
+            
+            // Check for ground beneath the entity
+            for (int z = -1; (z <= 1) && !controller->isGrounded; z++)
+            {
+                for (int x = -1; x <= 1; x++)
+                {
+                    // Only wall cells can collide (cells outside the map count as open)
+                    BoundingBox cellBounds = { 0 };
+                    if (GetMapWallBox(map, cellX + x, cellZ + z, &cellBounds))
+                    {
+                        // Check if the bottom is at or slightly above the cell's top
+                        if (bounds.min.y <= cellBounds.max.y && 
+                            bounds.min.y >= cellBounds.max.y - 0.1f &&
+                            CheckCollisionBoxes(bounds, cellBounds))
+                        {
+                            controller->isGrounded = true;
+                            transform->position.y = cellBounds.max.y;
+                            velocity->y = 0;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Update camera to follow player
+void UpdateGameCamera(Camera *camera, Vector3 target)
+{
+    // Update camera position to follow player from a top-down perspective
+    camera->position.x = target.x;
+    camera->position.z = target.z + 10.0f;
+    camera->target = target;
+}
+
+// Shoot bullet from a position in a direction
+void InitBulletPool(BulletPool *pool, int capacity)
+{
+    memset(pool, 0, sizeof(BulletPool));
+    GrowBulletPool(pool, capacity);
+}
+
+void UnloadBulletPool(BulletPool *pool)
+{
+    MemFree(pool->positionX);
+    MemFree(pool->positionY);
+    MemFree(pool->positionZ);
+    MemFree(pool->velocityX);
+    MemFree(pool->velocityY);
+    MemFree(pool->velocityZ);
+    MemFree(pool->previousX);
+    MemFree(pool->previousY);
+    MemFree(pool->previousZ);
+    MemFree(pool->radius);
+    MemFree(pool->fromPlayer);
+    MemFree(pool->expired);
+    memset(pool, 0, sizeof(BulletPool));
+}
+
+// Resize every array, live bullets stay where they are
+void GrowBulletPool(BulletPool *pool, int capacity)
+{
+    pool->positionX = (float *)MemRealloc(pool->positionX, capacity*sizeof(float));
+    pool->positionY = (float *)MemRealloc(pool->positionY, capacity*sizeof(float));
+    pool->positionZ = (float *)MemRealloc(pool->positionZ, capacity*sizeof(float));
+    pool->velocityX = (float *)MemRealloc(pool->velocityX, capacity*sizeof(float));
+    pool->velocityY = (float *)MemRealloc(pool->velocityY, capacity*sizeof(float));
+    pool->velocityZ = (float *)MemRealloc(pool->velocityZ, capacity*sizeof(float));
+    pool->previousX = (float *)MemRealloc(pool->previousX, capacity*sizeof(float));
+    pool->previousY = (float *)MemRealloc(pool->previousY, capacity*sizeof(float));
+    pool->previousZ = (float *)MemRealloc(pool->previousZ, capacity*sizeof(float));
+    pool->radius = (float *)MemRealloc(pool->radius, capacity*sizeof(float));
+    pool->fromPlayer = (bool *)MemRealloc(pool->fromPlayer, capacity*sizeof(bool));
+    pool->expired = (unsigned char *)MemRealloc(pool->expired, capacity);
+    pool->capacity = capacity;
+}
+
+void ShootBullet(BulletPool *pool, Vector3 position, Vector3 direction, bool fromPlayer)
+{
+    // Make room when the pool is full
+    if (pool->count >= pool->capacity) GrowBulletPool(pool, (pool->capacity > 0)? pool->capacity*2 : BULLET_POOL_CAPACITY);
+    
+    // Append to the end of the live range
+    int i = pool->count++;
+    
+    // Initialize the bullet
+    pool->positionX[i] = position.x;
+    pool->positionY[i] = position.y;
+    pool->positionZ[i] = position.z;
+    pool->previousX[i] = position.x;
+    pool->previousY[i] = position.y;
+    pool->previousZ[i] = position.z;
+    pool->velocityX[i] = direction.x*BULLET_SPEED;
+    pool->velocityY[i] = direction.y*BULLET_SPEED;
+    pool->velocityZ[i] = direction.z*BULLET_SPEED;
+    pool->radius[i] = BULLET_RADIUS;
+    pool->fromPlayer[i] = fromPlayer;
+}
+
+// Remove a live bullet, the last live bullet is moved into its slot
+// NOTE: Callers iterating the pool must revisit index after despawning
+void DespawnBullet(BulletPool *pool, int index)
+{
+    int last = --pool->count;
+    
+    pool->positionX[index] = pool->positionX[last];
+    pool->positionY[index] = pool->positionY[last];
+    pool->positionZ[index] = pool->positionZ[last];
+    pool->velocityX[index] = pool->velocityX[last];
+    pool->velocityY[index] = pool->velocityY[last];
+    pool->velocityZ[index] = pool->velocityZ[last];
+    pool->previousX[index] = pool->previousX[last];
+    pool->previousY[index] = pool->previousY[last];
+    pool->previousZ[index] = pool->previousZ[last];
+    pool->radius[index] = pool->radius[last];
+    pool->fromPlayer[index] = pool->fromPlayer[last];
+}
+
+// Update all live bullets
+void UpdateBullets(BulletPool *pool, float deltaTime)
+{
+    // Move every bullet and flag the ones that went too far (prevent infinitely traveling bullets)
+    IntegrateBullets(pool, deltaTime, BULLET_MAX_DISTANCE*BULLET_MAX_DISTANCE);
+    
+    // Walk backwards so the bullet swapped into a freed slot has already been checked
+    for (int i = pool->count - 1; i >= 0; i--)
+    {
+        if (pool->expired[i]) DespawnBullet(pool, i);
+    }
+}
+
+// Integration kernel: advance positions by velocity and flag bullets past the
+// despawn range, comparing squared distance from the origin (no sqrt needed)
+// Current positions are copied to the previous-position arrays first for render interpolation
+void IntegrateBullets(BulletPool *pool, float deltaTime, float maxDistanceSqr)
+{
+    memcpy(pool->previousX, pool->positionX, pool->count*sizeof(float));
+    memcpy(pool->previousY, pool->positionY, pool->count*sizeof(float));
+    memcpy(pool->previousZ, pool->positionZ, pool->count*sizeof(float));
+
+    float *px = pool->positionX;
+    float *py = pool->positionY;
+    float *pz = pool->positionZ;
+    const float *vx = pool->velocityX;
+    const float *vy = pool->velocityY;
+    const float *vz = pool->velocityZ;
+    unsigned char *expired = pool->expired;
+    int count = pool->count;
+    int i = 0;
+
+#if defined(__AVX__)
+    __m256 limit8 = _mm256_set1_ps(maxDistanceSqr);
+    __m256 dt8 = _mm256_set1_ps(deltaTime);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 x = _mm256_add_ps(_mm256_loadu_ps(px + i), _mm256_mul_ps(_mm256_loadu_ps(vx + i), dt8));
+        __m256 y = _mm256_add_ps(_mm256_loadu_ps(py + i), _mm256_mul_ps(_mm256_loadu_ps(vy + i), dt8));
+        __m256 z = _mm256_add_ps(_mm256_loadu_ps(pz + i), _mm256_mul_ps(_mm256_loadu_ps(vz + i), dt8));
+        _mm256_storeu_ps(px + i, x);
+        _mm256_storeu_ps(py + i, y);
+        _mm256_storeu_ps(pz + i, z);
+
+        __m256 distanceSqr = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z));
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(distanceSqr, limit8, _CMP_GT_OQ));
+        for (int k = 0; k < 8; k++) expired[i + k] = (mask >> k) & 1;
+    }
+#endif
+#if defined(__SSE__)
+    __m128 limit4 = _mm_set1_ps(maxDistanceSqr);
+    __m128 dt4 = _mm_set1_ps(deltaTime);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 x = _mm_add_ps(_mm_loadu_ps(px + i), _mm_mul_ps(_mm_loadu_ps(vx + i), dt4));
+        __m128 y = _mm_add_ps(_mm_loadu_ps(py + i), _mm_mul_ps(_mm_loadu_ps(vy + i), dt4));
+        __m128 z = _mm_add_ps(_mm_loadu_ps(pz + i), _mm_mul_ps(_mm_loadu_ps(vz + i), dt4));
+        _mm_storeu_ps(px + i, x);
+        _mm_storeu_ps(py + i, y);
+        _mm_storeu_ps(pz + i, z);
+
+        __m128 distanceSqr = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+        int mask = _mm_movemask_ps(_mm_cmpgt_ps(distanceSqr, limit4));
+        for (int k = 0; k < 4; k++) expired[i + k] = (mask >> k) & 1;
+    }
+#elif defined(__ARM_NEON)
+    float32x4_t limit4 = vdupq_n_f32(maxDistanceSqr);
+    for (; i + 4 <= count; i += 4)
+    {
+        float32x4_t x = vmlaq_n_f32(vld1q_f32(px + i), vld1q_f32(vx + i), deltaTime);
+        float32x4_t y = vmlaq_n_f32(vld1q_f32(py + i), vld1q_f32(vy + i), deltaTime);
+        float32x4_t z = vmlaq_n_f32(vld1q_f32(pz + i), vld1q_f32(vz + i), deltaTime);
+        vst1q_f32(px + i, x);
+        vst1q_f32(py + i, y);
+        vst1q_f32(pz + i, z);
+
+        float32x4_t distanceSqr = vmlaq_f32(vmlaq_f32(vmulq_f32(x, x), y, y), z, z);
+        uint32x4_t mask = vcgtq_f32(distanceSqr, limit4);
+        expired[i + 0] = vgetq_lane_u32(mask, 0) & 1;
+        expired[i + 1] = vgetq_lane_u32(mask, 1) & 1;
+        expired[i + 2] = vgetq_lane_u32(mask, 2) & 1;
+        expired[i + 3] = vgetq_lane_u32(mask, 3) & 1;
+    }
+#endif
+
+    // Scalar fallback, also handles the tail left over by the vector loops
+    for (; i < count; i++)
+    {
+        px[i] += vx[i]*deltaTime;
+        py[i] += vy[i]*deltaTime;
+        pz[i] += vz[i]*deltaTime;
+
+        float distanceSqr = px[i]*px[i] + py[i]*py[i] + pz[i]*pz[i];
+        expired[i] = (distanceSqr > maxDistanceSqr)? 1 : 0;
+    }
+}
+
+// Enemy AI: steer along the flow field and shoot at the player
+// Thinking runs as parallel jobs, shots are queued per job and spawned here afterwards
+// in enemy order, so the bullet pool and the random stream see the same sequence as a serial loop
+void UpdateEnemyAI(GameWorld *world, const MapCollision *map, const FlowField *flowField, const VisibilityGrid *visibility, float deltaTime)
+{
+    Archetype *enemies = &world->archetypes[ARCHETYPE_ENEMY];
+    int jobCount = (enemies->count + ENEMY_JOB_SIZE - 1)/ENEMY_JOB_SIZE;
+
+    // One command per enemy at most, only needed until the merge below
+    BulletCommand *commands = (BulletCommand *)PushArena(&frameArena, enemies->count*sizeof(BulletCommand));
+    int *commandCounts = (int *)PushArena(&frameArena, jobCount*sizeof(int));
+
+    EnemyJobData data = { enemies, world->archetypes[ARCHETYPE_PLAYER].transforms[0].position, deltaTime, map, flowField, visibility, commands, commandCounts };
+    RunJobs(&jobSystem, UpdateEnemyAIJob, &data, jobCount);
+
+    // Merge the command buffers
+    for (int job = 0; job < jobCount; job++)
+    {
+        for (int i = 0; i < commandCounts[job]; i++)
+        {
+            const BulletCommand *command = &commands[job*ENEMY_JOB_SIZE + i];
+
+            // Shoot bullet at player
+            ShootBullet(&world->bullets, command->position, command->direction, false);
+            
+            // Reset shoot timer with random variation
+            ShooterComponent *shooter = &enemies->shooters[command->enemy];
+            shooter->shootTimer = shooter->shootCooldown + GetRandomValue(-50, 50) / 100.0f;
+        }
+    }
+}
+
+// Think for one job's range of enemies, only touches those enemies and the job's command slice
+void UpdateEnemyAIJob(void *data, int job)
+{
+    EnemyJobData *jobData = (EnemyJobData *)data;
+    Archetype *enemies = jobData->enemies;
+    Vector3 target = jobData->target;
+
+    int first = job*ENEMY_JOB_SIZE;
+    int last = (first + ENEMY_JOB_SIZE < enemies->count)? first + ENEMY_JOB_SIZE : enemies->count;
+    BulletCommand *commands = &jobData->commands[first];
+    int commandCount = 0;
+
+    for (int i = first; i < last; i++)
+    {
+        Vector3 position = enemies->transforms[i].position;
+        VelocityComponent *velocity = &enemies->velocities[i];
+        ShooterComponent *shooter = &enemies->shooters[i];
+
+        // Head straight for the player when in range with nothing in the way, otherwise follow the flow field
+        float distance = Vector3Distance(target, position);
+        
+        velocity->velocity.x = 0.0f;
+        velocity->velocity.z = 0.0f;
+
+        // Only move if not too close to player
+        if (distance > 3.0f)
+        {
+            Vector3 size = enemies->colliders[i].size;
+            float reach = 0.5f*sqrtf(size.x*size.x + size.z*size.z);
+
+            Vector3 direction = { 0 };
+            if ((distance < 10.0f) && CheckMapClearPath(jobData->map, position, target, reach)) direction = Vector3Normalize((Vector3){ target.x - position.x, 0.0f, target.z - position.z });
+            else direction = GetFlowFieldDirection(jobData->flowField, jobData->map, position, target);
+            velocity->velocity.x = direction.x*velocity->speed;
+            velocity->velocity.z = direction.z*velocity->speed;
+        }
+        
+        // Shooting logic - enemies shoot at player periodically
+        // Only shoot if player is within range and in view, shots into walls would only cost bullets
+        shooter->shootTimer -= jobData->deltaTime;
+        if (shooter->shootTimer <= 0 && distance < 10.0f && IsVisibleFromViewer(jobData->visibility, jobData->map, position))
+        {
+            // Calculate direction to player, the bullet is spawned after all jobs are done
+            BulletCommand *command = &commands[commandCount++];
+            command->enemy = i;
+            command->position = (Vector3){ position.x, position.y + 0.5f, position.z };
+            command->direction = Vector3Normalize(Vector3Subtract(
+                (Vector3){ target.x, target.y + 0.5f, target.z },
+                command->position
+            ));
+        }
+    }
+
+    jobData->commandCounts[job] = commandCount;
+}
+
+// Move every entity with a velocity and a collider against the map, on the XZ plane
+// Runs as parallel jobs per archetype, each entity only touches its own components
+void UpdateMovement(GameWorld *world, const MapCollision *map, float deltaTime)
+{
+    for (int a = 0; a < ARCHETYPE_COUNT; a++)
+    {
+        Archetype *archetype = &world->archetypes[a];
+        if (!HasComponents(archetype, COMPONENT_TRANSFORM | COMPONENT_VELOCITY | COMPONENT_COLLIDER)) continue;
+
+        MovementJobData data = { archetype, deltaTime, map };
+        RunJobs(&jobSystem, UpdateMovementJob, &data, (archetype->count + ENEMY_JOB_SIZE - 1)/ENEMY_JOB_SIZE);
+    }
+}
+
+void UpdateMovementJob(void *data, int job)
+{
+    MovementJobData *jobData = (MovementJobData *)data;
+    Archetype *archetype = jobData->archetype;
+    const MapCollision *map = jobData->map;
+    bool controlled = HasComponents(archetype, COMPONENT_CONTROLLER);
+
+    int first = job*ENEMY_JOB_SIZE;
+    int last = (first + ENEMY_JOB_SIZE < archetype->count)? first + ENEMY_JOB_SIZE : archetype->count;
+
+    for (int i = first; i < last; i++)
+    {
+        TransformComponent *transform = &archetype->transforms[i];
+        ColliderComponent collider = archetype->colliders[i];
+        Vector3 velocity = archetype->velocities[i].velocity;
+
+        // Controlled entities are always tested so standing on a wall top still counts as ground
+        if (!controlled && (velocity.x == 0.0f) && (velocity.z == 0.0f)) continue;
+
+        // Sweep the collider along the step, sliding along whatever it runs into
+        Vector3 step = { velocity.x*jobData->deltaTime, 0.0f, velocity.z*jobData->deltaTime };
+        Vector3 moved = SweepBoxWithMap(GetEntityBoundingBox(*transform, collider), step, map);
+        transform->position.x += moved.x;
+        transform->position.z += moved.z;
+
+        // Update grounded state based on ground contact
+        if (controlled && ((transform->position.y <= 0.5f) || CheckGroundContactWithMap(GetEntityBoundingBox(*transform, collider), map)))  // Also check if at the base height
+        {
+            archetype->controllers[i].isGrounded = true;
+        }
+    }
+}
+
+// Check all bullet collisions with player, enemies, and map
+void CheckBulletCollisions(BulletPool *pool, Archetype *players, Archetype *enemies, const MapCollision *map, const SpatialGrid *enemyGrid)
+{
+    int nearby[MAX_NEARBY_ENEMIES];
+    int i = 0;
+    while (i < pool->count)
+    {
+        Vector3 position = { pool->positionX[i], pool->positionY[i], pool->positionZ[i] };
+        Vector3 previous = { pool->previousX[i], pool->previousY[i], pool->previousZ[i] };
+        float radius = pool->radius[i];
+        bool hit = false;
+        
+        // Check collision with map along the whole path of this tick
+        if (CheckCollisionBulletPathWithMap(previous, position, radius, map))
+        {
+            hit = true;
+        }
+        // Check collision with player (only enemy bullets)
+        else if (!pool->fromPlayer[i])
+        {
+            for (int p = 0; p < players->count; p++)
+            {
+                BoundingBox playerBox = GetEntityBoundingBox(players->transforms[p], players->colliders[p]);
+                if (CheckCollisionSphereBox(position, radius, playerBox))
+                {
+                    // Player hit by enemy bullet, only takes damage if not in hit state
+                    ApplyDamage(&players->healths[p], &players->hitFlashes[p], 10);
+                    hit = true;
+                    break;
+                }
+            }
+        }
+        // Check collision with enemies (only player bullets)
+        // Only enemies bucketed in the cells around the bullet can be touching it
+        else
+        {
+            int nearbyCount = QuerySpatialGrid(enemyGrid, map, position, nearby, MAX_NEARBY_ENEMIES);
+            
+            for (int n = 0; n < nearbyCount; n++)
+            {
+                int j = nearby[n];
+                
+                // Enemies killed earlier this frame are still bucketed
+                if (enemies->healths[j].health > 0)
+                {
+                    BoundingBox enemyBox = GetEntityBoundingBox(enemies->transforms[j], enemies->colliders[j]);
+                    if (CheckCollisionSphereBox(position, radius, enemyBox))
+                    {
+                        // Enemy hit by player bullet, removed after the collision pass once its health runs out
+                        ApplyDamage(&enemies->healths[j], &enemies->hitFlashes[j], 10);
+                        hit = true;
+                        break;
+                    }
+                }
+            }
+        }
+        
+        // Despawned slots get refilled from the end, so only advance on survivors
+        if (hit) DespawnBullet(pool, i);
+        else i++;
+    }
+}
+
+// Zeroed like MemAlloc(), valid until the arena is reset
+void *PushArena(MemoryArena *arena, size_t size)
+{
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    arena->pushed += size;
+
+    unsigned char *memory = NULL;
+    if (arena->used + size <= arena->size)
+    {
+        memory = arena->base + arena->used;
+        arena->used += size;
+    }
+    else
+    {
+        // Header padded to the alignment so the memory after it stays aligned
+        ArenaBlock *block = (ArenaBlock *)MemAlloc(ARENA_ALIGNMENT + size);
+        block->next = arena->overflow;
+        arena->overflow = block;
+        memory = (unsigned char *)block + ARENA_ALIGNMENT;
+    }
+
+    memset(memory, 0, size);
+
+    return memory;
+}
+
+// Release everything pushed, the block grows to the peak if anything spilled over
+void ResetMemoryArena(MemoryArena *arena)
+{
+    if (arena->overflow != NULL)
+    {
+        while (arena->overflow != NULL)
+        {
+            ArenaBlock *next = arena->overflow->next;
+            MemFree(arena->overflow);
+            arena->overflow = next;
+        }
+
+        // Nothing in it is live any more, no need to keep the contents
+        arena->size = arena->pushed;
+        MemFree(arena->base);
+        arena->base = (unsigned char *)MemAlloc(arena->size);
+    }
+
+    arena->used = 0;
+    arena->pushed = 0;
+}
+
+void UnloadMemoryArena(MemoryArena *arena)
+{
+    ResetMemoryArena(arena);
+    MemFree(arena->base);
+    memset(arena, 0, sizeof(MemoryArena));
+}
+
+// Decode the cubicmap image into a CPU-side wall grid
+// Same threshold the collision code used on the GPU readback: any bright pixel is a wall
+CollisionGrid LoadCollisionGrid(Image image)
+{
+    CollisionGrid grid = { 0 };
+    grid.width = image.width;
+    grid.height = image.height;
+    grid.cells = (unsigned char *)PushArena(&levelArena, grid.width*grid.height);
+
+    Color *pixels = LoadImageColors(image);
+
+    for (int i = 0; i < grid.width*grid.height; i++)
+    {
+        grid.cells[i] = ((pixels[i].r > 50) && (pixels[i].g > 50) && (pixels[i].b > 50))? 1 : 0;
+    }
+
+    UnloadImageColors(pixels);
+
+    return grid;
+}
+
+// Level copy, for grids that live in a buffer someone else frees
+CollisionGrid LoadCollisionGridCopy(const CollisionGrid *grid)
+{
+    CollisionGrid copy = *grid;
+    copy.cells = (unsigned char *)PushArena(&levelArena, grid->width*grid->height);
+    memcpy(copy.cells, grid->cells, grid->width*grid->height);
+
+    return copy;
+}
+
+// Check if a map cell is a wall, cells outside the grid are treated as open
+bool IsCollisionGridWall(const CollisionGrid *grid, int x, int z)
+{
+    if (x < 0 || z < 0 || x >= grid->width || z >= grid->height) return false;
+
+    return grid->cells[z*grid->width + x] != 0;
+}
+
+// Build the map collision context from the cubicmap image
+// Cells are unit cubes centered on integer offsets from the map position,
+// matching the layout GenMeshCubicmap() produces for a cube size of 1
+MapCollision LoadMapCollision(Image image, Vector3 position)
+{
+    return LoadMapCollisionFromGrid(LoadCollisionGrid(image), position);
+}
+
+// Build the map collision context around a grid from the level arena
+MapCollision LoadMapCollisionFromGrid(CollisionGrid grid, Vector3 position)
+{
+    MapCollision map = { 0 };
+    map.grid = grid;
+    map.position = position;
+
+    int width = map.grid.width;
+    int height = map.grid.height;
+
+    map.bounds.min = (Vector3){ position.x - 0.5f, position.y, position.z - 0.5f };
+    map.bounds.max = (Vector3){ position.x + width - 0.5f, position.y + 1.0f, position.z + height - 0.5f };
+
+    LoadMapClearance(&map);
+
+    return map;
+}
+
+// Distance from each cell to the nearest wall cell or the outside of the map, as gaps between unit squares
+// Separable, linear in the cell count: the nearest solid along each row first, then per column
+// the lower envelope of the parabolas rowDistance[row] + (z - row)^2 (Felzenszwalb-Huttenlocher)
+// NOTE: A lower bound for every point in the cell, so one lookup can rule out any wall within that distance
+void LoadMapClearance(MapCollision *map)
+{
+    int width = map->grid.width;
+    int height = map->grid.height;
+    float *rowDistance = (float *)PushArena(&frameArena, width*height*sizeof(float));
+    map->clearance = (float *)PushArena(&levelArena, width*height*sizeof(float));
+
+    // Squared gap between two cells k apart on one axis
+    #define CLEARANCE_GAP(k) (((k) > 1)? (float)(((k) - 1)*((k) - 1)) : 0.0f)
+
+    for (int z = 0; z < height; z++)
+    {
+        // Nearest solid on each side, the cells just past the map edge count as solid
+        int left = -1;
+        for (int x = 0; x < width; x++)
+        {
+            if (IsCollisionGridWall(&map->grid, x, z)) left = x;
+            rowDistance[z*width + x] = CLEARANCE_GAP(x - left);
+        }
+
+        int right = width;
+        for (int x = width - 1; x >= 0; x--)
+        {
+            if (IsCollisionGridWall(&map->grid, x, z)) right = x;
+            rowDistance[z*width + x] = fminf(rowDistance[z*width + x], CLEARANCE_GAP(right - x));
+        }
+    }
+
+    // Column samples run from the solid row before the map to the one after it, so sample i is row i - 1
+    int samples = height + 2;
+    float *column = (float *)PushArena(&frameArena, samples*sizeof(float));
+    float *envelope = (float *)PushArena(&frameArena, samples*sizeof(float));
+    int *parabolas = (int *)PushArena(&frameArena, samples*sizeof(int));
+    float *starts = (float *)PushArena(&frameArena, (samples + 1)*sizeof(float));
+
+    for (int x = 0; x < width; x++)
+    {
+        column[0] = 0.0f;
+        column[samples - 1] = 0.0f;
+        for (int z = 0; z < height; z++) column[z + 1] = rowDistance[z*width + x];
+
+        // Lower envelope: parabolas[i] owns every sample from starts[i] up to starts[i + 1]
+        int count = 0;
+        parabolas[0] = 0;
+        starts[0] = -INFINITY;
+        starts[1] = INFINITY;
+        for (int q = 1; q < samples; q++)
+        {
+            float s = 0.0f;
+            for (;;)
+            {
+                int p = parabolas[count];
+                s = ((column[q] + (float)(q*q)) - (column[p] + (float)(p*p)))/(float)(2*(q - p));
+                if (s > starts[count]) break;
+                count--;
+            }
+
+            count++;
+            parabolas[count] = q;
+            starts[count] = s;
+            starts[count + 1] = INFINITY;
+        }
+
+        for (int q = 0, i = 0; q < samples; q++)
+        {
+            while (starts[i + 1] < (float)q) i++;
+            envelope[q] = column[parabolas[i]] + (float)((q - parabolas[i])*(q - parabolas[i]));
+        }
+
+        // The gap (k - 1)^2 is the nearest of k - 1, k and k + 1 squared, so take the best neighbouring sample
+        for (int z = 0; z < height; z++)
+        {
+            float best = fminf(envelope[z], fminf(envelope[z + 1], envelope[z + 2]));
+            map->clearance[z*width + x] = sqrtf(best);
+        }
+    }
+
+    #undef CLEARANCE_GAP
+}
+
+// Lower bound of the distance from a position to the nearest wall on the XZ plane, 0 in or next to a wall
+float GetMapClearance(const MapCollision *map, Vector3 position)
+{
+    int cellX, cellZ;
+    GetMapCell(map, position, &cellX, &cellZ);
+    if ((cellX < 0) || (cellZ < 0) || (cellX >= map->grid.width) || (cellZ >= map->grid.height)) return 0.0f;
+
+    return map->clearance[cellZ*map->grid.width + cellX];
+}
+
+// Check if a circle of radius can travel straight from start to end without touching a wall
+// Conservative: every cell the centre line crosses must have that much clearance
+bool CheckMapClearPath(const MapCollision *map, Vector3 start, Vector3 end, float radius)
+{
+    GridMarch march = InitGridMarch(map, start, end);
+    while (NextGridMarchCell(&march))
+    {
+        if ((march.cellX < 0) || (march.cellZ < 0) || (march.cellX >= map->grid.width) || (march.cellZ >= map->grid.height)) return false;
+        if (IsCollisionGridWall(&map->grid, march.cellX, march.cellZ)) return false;
+        if (map->clearance[march.cellZ*map->grid.width + march.cellX] < radius) return false;
+    }
+
+    return true;
+}
+
+// Start walking the cells from start to end, grid cell (x, z) covers [x, x + 1) and [z, z + 1) from the map's min corner
+GridMarch InitGridMarch(const MapCollision *map, Vector3 start, Vector3 end)
+{
+    GridMarch march = { 0 };
+    float deltaX = end.x - start.x;
+    float deltaZ = end.z - start.z;
+    float gridX = start.x - map->bounds.min.x;
+    float gridZ = start.z - map->bounds.min.z;
+
+    GetMapCell(map, start, &march.cellX, &march.cellZ);
+    march.stepX = (deltaX > 0.0f)? 1 : -1;
+    march.stepZ = (deltaZ > 0.0f)? 1 : -1;
+    march.crossX = (deltaX != 0.0f)? fabsf(1.0f/deltaX) : INFINITY;
+    march.crossZ = (deltaZ != 0.0f)? fabsf(1.0f/deltaZ) : INFINITY;
+    march.nextX = (deltaX > 0.0f)? (march.cellX + 1 - gridX)*march.crossX : ((deltaX < 0.0f)? (gridX - march.cellX)*march.crossX : INFINITY);
+    march.nextZ = (deltaZ > 0.0f)? (march.cellZ + 1 - gridZ)*march.crossZ : ((deltaZ < 0.0f)? (gridZ - march.cellZ)*march.crossZ : INFINITY);
+    int endX, endZ;
+    GetMapCell(map, end, &endX, &endZ);
+    march.cellsLeft = abs(endX - march.cellX) + abs(endZ - march.cellZ) + 1;
+
+    // Flags the start cell, the first call to NextGridMarchCell() visits it without stepping
+    march.enter = -1.0f;
+
+    return march;
+}
+
+// Advance to the next cell crossed, false once the end cell has been visited
+bool NextGridMarchCell(GridMarch *march)
+{
+    if (march->cellsLeft <= 0) return false;
+
+    if (march->enter >= 0.0f)
+    {
+        // Step over whichever boundary comes first
+        if (march->nextX < march->nextZ)
+        {
+            march->cellX += march->stepX;
+            march->nextX += march->crossX;
+        }
+        else
+        {
+            march->cellZ += march->stepZ;
+            march->nextZ += march->crossZ;
+        }
+    }
+
+    march->enter = march->leave;
+    march->leave = fminf(fminf(march->nextX, march->nextZ), 1.0f);
+    march->cellsLeft--;
+
+    return true;
+}
+
+// Carve a rooms-and-corridors floor straight into a collision grid, every cell starts as wall
+// Rooms are placed at random and dropped if they touch an earlier one, each new room is
+// joined to the previous room with an L-shaped corridor so the whole floor is connected
+// NOTE: Private xorshift generator, the same seed always gives the same floor without touching raylib's random stream
+CollisionGrid GenCollisionGridDungeon(int width, int height, unsigned int seed, int *spawnX, int *spawnZ)
+{
+    CollisionGrid grid = { 0 };
+    grid.width = width;
+    grid.height = height;
+    grid.cells = (unsigned char *)PushArena(&levelArena, width*height);
+    memset(grid.cells, 1, width*height);
+
+    unsigned int rngState = (seed != 0)? seed : 1;      // Xorshift state must be non-zero
+
+    // Xorshift32, then reduced to [0..range-1]
+    #define DUNGEON_RANDOM(range) (rngState ^= rngState << 13, rngState ^= rngState >> 17, rngState ^= rngState << 5, (int)(rngState%(unsigned int)(range)))
+
+    // Same room density at any size, the default floor gets exactly DUNGEON_MAX_ROOMS
+    int maxRooms = (int)((long)DUNGEON_MAX_ROOMS*width*height/(DUNGEON_SIZE*DUNGEON_SIZE));
+    if (maxRooms < DUNGEON_MAX_ROOMS) maxRooms = DUNGEON_MAX_ROOMS;
+    int attempts = DUNGEON_ROOM_ATTEMPTS*(maxRooms/DUNGEON_MAX_ROOMS);
+
+    int *roomX = (int *)PushArena(&frameArena, 4*maxRooms*sizeof(int));
+    int *roomZ = roomX + maxRooms;
+    int *roomWidth = roomZ + maxRooms;
+    int *roomHeight = roomWidth + maxRooms;
+    int roomCount = 0;
+
+    for (int attempt = 0; (attempt < attempts) && (roomCount < maxRooms); attempt++)
+    {
+        int w = DUNGEON_ROOM_MIN + DUNGEON_RANDOM(DUNGEON_ROOM_MAX - DUNGEON_ROOM_MIN + 1);
+        int h = DUNGEON_ROOM_MIN + DUNGEON_RANDOM(DUNGEON_ROOM_MAX - DUNGEON_ROOM_MIN + 1);
+        if ((w > width - 2) || (h > height - 2)) continue;
+
+        // Keep a wall border around the floor
+        int x = 1 + DUNGEON_RANDOM(width - w - 1);
+        int z = 1 + DUNGEON_RANDOM(height - h - 1);
+
+        // Leave at least one wall cell between rooms
+        bool overlaps = false;
+        for (int i = 0; (i < roomCount) && !overlaps; i++)
+        {
+            overlaps = (x <= roomX[i] + roomWidth[i]) && (x + w >= roomX[i]) &&
+                       (z <= roomZ[i] + roomHeight[i]) && (z + h >= roomZ[i]);
+        }
+        if (overlaps) continue;
+
+        CarveCollisionGrid(&grid, x, z, w, h);
+
+        if (roomCount > 0)
+        {
+            // Two cells wide so corridors stay easy to walk and shoot down
+            int fromX = roomX[roomCount - 1] + roomWidth[roomCount - 1]/2;
+            int fromZ = roomZ[roomCount - 1] + roomHeight[roomCount - 1]/2;
+            int toX = x + w/2;
+            int toZ = z + h/2;
+            int minX = (fromX < toX)? fromX : toX;
+            int minZ = (fromZ < toZ)? fromZ : toZ;
+            int spanX = abs(toX - fromX) + 2;
+            int spanZ = abs(toZ - fromZ) + 2;
+
+            if (DUNGEON_RANDOM(2) == 0)
+            {
+                CarveCollisionGrid(&grid, minX, fromZ, spanX, 2);     // Horizontal first, then vertical
+                CarveCollisionGrid(&grid, toX, minZ, 2, spanZ);
+            }
+            else
+            {
+                CarveCollisionGrid(&grid, fromX, minZ, 2, spanZ);     // Vertical first, then horizontal
+                CarveCollisionGrid(&grid, minX, toZ, spanX, 2);
+            }
+        }
+
+        roomX[roomCount] = x;
+        roomZ[roomCount] = z;
+        roomWidth[roomCount] = w;
+        roomHeight[roomCount] = h;
+        roomCount++;
+    }
+
+    #undef DUNGEON_RANDOM
+
+    // The player starts in the middle of the first room
+    if (roomCount == 0)
+    {
+        roomX[0] = width/2 - 1;
+        roomZ[0] = height/2 - 1;
+        roomWidth[0] = 2;
+        roomHeight[0] = 2;
+        CarveCollisionGrid(&grid, roomX[0], roomZ[0], 2, 2);
+    }
+
+    *spawnX = roomX[0] + roomWidth[0]/2;
+    *spawnZ = roomZ[0] + roomHeight[0]/2;
+
+    return grid;
+}
+
+// Open up a rectangle of cells, clamped so the outer wall border is never carved
+void CarveCollisionGrid(CollisionGrid *grid, int x, int z, int width, int height)
+{
+    int minX = (x < 1)? 1 : x;
+    int minZ = (z < 1)? 1 : z;
+    int maxX = (x + width > grid->width - 1)? grid->width - 1 : x + width;
+    int maxZ = (z + height > grid->height - 1)? grid->height - 1 : z + height;
+
+    for (int cellZ = minZ; cellZ < maxZ; cellZ++)
+    {
+        for (int cellX = minX; cellX < maxX; cellX++) grid->cells[cellZ*grid->width + cellX] = 0;
+    }
+}
+
+// Generate a new floor and wrap it in a map collision context
+MapCollision LoadDungeonFloor(unsigned int seed, int size, Vector3 position, int *spawnX, int *spawnZ)
+{
+    double start = GetProfilerTime();
+
+    MapCollision map = LoadMapCollisionFromGrid(GenCollisionGridDungeon(size, size, seed, spawnX, spawnZ), position);
+
+    TraceLog(LOG_INFO, "DUNGEON: Floor generated (seed %u, %ix%i cells) in %.3f ms", seed, map.grid.width, map.grid.height, (GetProfilerTime() - start)*1000.0);
+
+    return map;
+}
+
+// Minimap texture straight from the collision grid: walls white, floor black, like map.png
+Texture2D LoadCollisionGridTexture(const CollisionGrid *grid)
+{
+    Color *pixels = (Color *)PushArena(&frameArena, grid->width*grid->height*sizeof(Color));
+    for (int i = 0; i < grid->width*grid->height; i++) pixels[i] = (grid->cells[i] != 0)? WHITE : BLACK;
+
+    Image image = { pixels, grid->width, grid->height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 };
+
+    return LoadTextureFromImage(image);
+}
+
+// Cell under a world position, the inverse of GetMapCellBox(), every map grid lookup goes through here
+// NOTE: Not clamped, positions off the map give cells outside the grid (below the min edge is -1, not 0)
+void GetMapCell(const MapCollision *map, Vector3 position, int *cellX, int *cellZ)
+{
+    *cellX = (int)floorf(position.x - map->bounds.min.x);
+    *cellZ = (int)floorf(position.z - map->bounds.min.z);
+}
+
+// World-space box of any cell, walls or not
+BoundingBox GetMapCellBox(const MapCollision *map, int cellX, int cellZ)
+{
+    return (BoundingBox){
+        (Vector3){ map->bounds.min.x + cellX, map->bounds.min.y, map->bounds.min.z + cellZ },
+        (Vector3){ map->bounds.min.x + cellX + 1.0f, map->bounds.max.y, map->bounds.min.z + cellZ + 1.0f }
+    };
+}
+
+// Get the world-space box of a wall cell, false if the cell is open or outside the map
+bool GetMapWallBox(const MapCollision *map, int cellX, int cellZ, BoundingBox *box)
+{
+    if (!IsCollisionGridWall(&map->grid, cellX, cellZ)) return false;
+
+    *box = GetMapCellBox(map, cellX, cellZ);
+    return true;
+}
+
+// Build the wall wireframe line list for a rectangle of cells from the collision grid
+// Edges are walked on the grid corners, so an edge shared by neighbouring walls is emitted once
+// NOTE: A region owns the corners on its min edges, the far map edge belongs to the last region,
+// so neighbouring regions never emit the same line
+MapWireframe LoadMapWireframe(const MapCollision *map, int cellX, int cellZ, int width, int height)
+{
+    MapWireframe wireframe = { 0 };
+
+    const CollisionGrid *grid = &map->grid;
+    int endX = cellX + width + ((cellX + width >= grid->width)? 1 : 0);
+    int endZ = cellZ + height + ((cellZ + height >= grid->height)? 1 : 0);
+
+    // Worst case: one vertical edge per corner, plus top and bottom edges along x and z
+    int maxLines = 5*(endX - cellX)*(endZ - cellZ);
+    wireframe.vertices = (Vector3 *)MemAlloc(maxLines*2*sizeof(Vector3));
+
+    float bottom = map->bounds.min.y;
+    float top = map->bounds.max.y;
+
+    for (int j = cellZ; j < endZ; j++)
+    {
+        for (int i = cellX; i < endX; i++)
+        {
+            float cornerX = map->bounds.min.x + i;
+            float cornerZ = map->bounds.min.z + j;
+
+            bool wallNW = IsCollisionGridWall(grid, i - 1, j - 1);
+            bool wallNE = IsCollisionGridWall(grid, i, j - 1);
+            bool wallSW = IsCollisionGridWall(grid, i - 1, j);
+            bool wallSE = IsCollisionGridWall(grid, i, j);
+
+            // Vertical edge on this corner
+            if (wallNW || wallNE || wallSW || wallSE)
+            {
+                wireframe.vertices[wireframe.vertexCount++] = (Vector3){ cornerX, bottom, cornerZ };
+                wireframe.vertices[wireframe.vertexCount++] = (Vector3){ cornerX, top, cornerZ };
+            }
+
+            // Top and bottom edges running along x from this corner
+            if (wallNE || wallSE)
+            {
+                wireframe.vertices[wireframe.vertexCount++] = (Vector3){ cornerX, bottom, cornerZ };
+                wireframe.vertices[wireframe.vertexCount++] = (Vector3){ cornerX + 1.0f, bottom, cornerZ };
+                wireframe.vertices[wireframe.vertexCount++] = (Vector3){ cornerX, top, cornerZ };
+                wireframe.vertices[wireframe.vertexCount++] = (Vector3){ cornerX + 1.0f, top, cornerZ };
+            }
+
+            // Top and bottom edges running along z from this corner
+            if (wallSW || wallSE)
+            {
+                wireframe.vertices[wireframe.vertexCount++] = (Vector3){ cornerX, bottom, cornerZ };
+                wireframe.vertices[wireframe.vertexCount++] = (Vector3){ cornerX, bottom, cornerZ + 1.0f };
+                wireframe.vertices[wireframe.vertexCount++] = (Vector3){ cornerX, top, cornerZ };
+                wireframe.vertices[wireframe.vertexCount++] = (Vector3){ cornerX, top, cornerZ + 1.0f };
+            }
+        }
+    }
+
+    return wireframe;
+}
+
+void UnloadMapWireframe(MapWireframe wireframe)
+{
+    MemFree(wireframe.vertices);
+}
+
+// Draw the wall wireframe of the visible resident chunks plus the 3x3 debug cells around the player
+// Everything goes out as a single line batch
+void DrawMapWireframe(const WorldStream *stream, const MapCollision *map, Vector3 playerPosition, const Frustum *frustum)
+{
+    // Box edges as pairs of corner indices, corners are numbered by (x, y, z) bits
+    static const int boxEdges[12][2] = {
+        { 0, 1 }, { 2, 3 }, { 4, 5 }, { 6, 7 },     // Along x
+        { 0, 2 }, { 1, 3 }, { 4, 6 }, { 5, 7 },     // Along y
+        { 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 }      // Along z
+    };
+
+    Vector3 playerCenter = { playerPosition.x, playerPosition.y + 0.5f, playerPosition.z };
+    int cellX, cellZ;
+    GetMapCell(map, playerPosition, &cellX, &cellZ);
+
+    rlBegin(RL_LINES);
+
+        // Static wall edges
+        rlColor4ub(BLUE.r, BLUE.g, BLUE.b, BLUE.a);
+        for (int c = 0; c < WORLD_STREAM_SLOTS; c++)
+        {
+            const WorldChunk *chunk = &stream->slots[c];
+            if (!chunk->drawable || ((frustum != NULL) && !IsBoxInFrustum(frustum, chunk->bounds))) continue;
+
+            const MapWireframe *wireframe = &chunk->wireframe;
+            for (int i = 0; i < wireframe->vertexCount; i++)
+            {
+                rlVertex3f(wireframe->vertices[i].x, wireframe->vertices[i].y, wireframe->vertices[i].z);
+            }
+        }
+
+        // Cells around the player, with a line from the player to each cell center
+        rlColor4ub(GREEN.r, GREEN.g, GREEN.b, GREEN.a);
+        for (int z = -1; z <= 1; z++)
+        {
+            for (int x = -1; x <= 1; x++)
+            {
+                int currentCellX = cellX + x;
+                int currentCellZ = cellZ + z;
+
+                // Skip cells outside the map bounds
+                if (currentCellX < 0 || currentCellZ < 0 ||
+                    currentCellX >= map->grid.width || currentCellZ >= map->grid.height)
+                    continue;
+
+                BoundingBox cellBounds = GetMapCellBox(map, currentCellX, currentCellZ);
+
+                for (int e = 0; e < 12; e++)
+                {
+                    for (int k = 0; k < 2; k++)
+                    {
+                        int corner = boxEdges[e][k];
+                        rlVertex3f((corner & 1)? cellBounds.max.x : cellBounds.min.x,
+                                   (corner & 2)? cellBounds.max.y : cellBounds.min.y,
+                                   (corner & 4)? cellBounds.max.z : cellBounds.min.z);
+                    }
+                }
+
+                rlVertex3f(playerCenter.x, playerCenter.y, playerCenter.z);
+                rlVertex3f((cellBounds.min.x + cellBounds.max.x)*0.5f, playerPosition.y, (cellBounds.min.z + cellBounds.max.z)*0.5f);
+            }
+        }
+
+    rlEnd();
+}
+
+// Allocate a spatial grid covering the map, one bucket per map cell
+SpatialGrid LoadSpatialGrid(const MapCollision *map, int capacity)
+{
+    SpatialGrid grid = { 0 };
+    grid.width = map->grid.width;
+    grid.height = map->grid.height;
+    grid.capacity = capacity;
+    grid.cellStart = (int *)PushArena(&levelArena, (grid.width*grid.height + 1)*sizeof(int));
+    grid.entries = (int *)PushArena(&levelArena, capacity*sizeof(int));
+    grid.entityCell = (int *)PushArena(&levelArena, capacity*sizeof(int));
+
+    return grid;
+}
+
+// Get the bucket index for a world position, positions off the map clamp to the border cells
+int GetSpatialGridCell(const SpatialGrid *grid, const MapCollision *map, Vector3 position)
+{
+    int cellX, cellZ;
+    GetMapCell(map, position, &cellX, &cellZ);
+
+    if (cellX < 0) cellX = 0;
+    else if (cellX >= grid->width) cellX = grid->width - 1;
+    if (cellZ < 0) cellZ = 0;
+    else if (cellZ >= grid->height) cellZ = grid->height - 1;
+
+    return cellZ*grid->width + cellX;
+}
+
+// Rebuild the buckets from a packed transform array (counting sort, two passes over the entities)
+void BuildSpatialGrid(SpatialGrid *grid, const MapCollision *map, const TransformComponent *transforms, int count)
+{
+    int cellCount = grid->width*grid->height;
+    if (count > grid->capacity)
+    {
+        // Wave outgrew the grid, keep up with the archetype, every build rewrites both arrays so nothing is copied
+        grid->capacity = count*2;
+        grid->entries = (int *)PushArena(&levelArena, grid->capacity*sizeof(int));
+        grid->entityCell = (int *)PushArena(&levelArena, grid->capacity*sizeof(int));
+    }
+
+    for (int c = 0; c <= cellCount; c++) grid->cellStart[c] = 0;
+
+    // Count entities per cell, shifted by one so the prefix sum lands on the start offsets
+    for (int i = 0; i < count; i++)
+    {
+        int cell = GetSpatialGridCell(grid, map, transforms[i].position);
+        grid->entityCell[i] = cell;
+        grid->cellStart[cell + 1]++;
+    }
+
+    for (int c = 0; c < cellCount; c++) grid->cellStart[c + 1] += grid->cellStart[c];
+
+    // Scatter, using the start offsets as write cursors and restoring them afterwards
+    for (int i = 0; i < count; i++)
+    {
+        int cell = grid->entityCell[i];
+        grid->entries[grid->cellStart[cell]++] = i;
+    }
+
+    for (int c = cellCount; c > 0; c--) grid->cellStart[c] = grid->cellStart[c - 1];
+    grid->cellStart[0] = 0;
+}
+
+// Gather the entities bucketed in the 3x3 cells around a position
+// Returns the number of indices written to results
+int QuerySpatialGrid(const SpatialGrid *grid, const MapCollision *map, Vector3 position, int *results, int maxResults)
+{
+    int center = GetSpatialGridCell(grid, map, position);
+    int centerX = center%grid->width;
+    int centerZ = center/grid->width;
+    int count = 0;
+
+    for (int z = centerZ - 1; z <= centerZ + 1; z++)
+    {
+        if (z < 0 || z >= grid->height) continue;
+
+        for (int x = centerX - 1; x <= centerX + 1; x++)
+        {
+            if (x < 0 || x >= grid->width) continue;
+
+            int cell = z*grid->width + x;
+            for (int e = grid->cellStart[cell]; (e < grid->cellStart[cell + 1]) && (count < maxResults); e++)
+            {
+                results[count++] = grid->entries[e];
+            }
+        }
+    }
+
+    return count;
+}
+
+FlowField LoadFlowField(const MapCollision *map)
+{
+    FlowField field = { 0 };
+    field.width = map->grid.width;
+    field.height = map->grid.height;
+    field.targetCell = -1;
+    field.distance = (unsigned short *)PushArena(&levelArena, field.width*field.height*sizeof(unsigned short));
+    field.next = (int *)PushArena(&levelArena, field.width*field.height*sizeof(int));
+    field.queue = (int *)PushArena(&levelArena, field.width*field.height*sizeof(int));
+
+    return field;
+}
+
+// Get the cell under a world position, -1 if it's off the map
+int GetFlowFieldCell(const FlowField *field, const MapCollision *map, Vector3 position)
+{
+    int cellX, cellZ;
+    GetMapCell(map, position, &cellX, &cellZ);
+
+    if (cellX < 0 || cellZ < 0 || cellX >= field->width || cellZ >= field->height) return -1;
+
+    return cellZ*field->width + cellX;
+}
+
+// Rebuild the field when the target moved to another cell, otherwise nothing to do
+// BFS over the 4-connected open cells, then every cell picks its lowest neighbour,
+// diagonals only when both side cells are open so steps never cut a wall corner
+void UpdateFlowField(FlowField *field, const MapCollision *map, Vector3 target)
+{
+    int targetCell = GetFlowFieldCell(field, map, target);
+    if ((targetCell == field->targetCell) && (targetCell != -1)) return;
+    field->targetCell = targetCell;
+
+    int cellCount = field->width*field->height;
+    for (int i = 0; i < cellCount; i++)
+    {
+        field->distance[i] = FLOW_FIELD_UNREACHED;
+        field->next[i] = -1;
+    }
+
+    // Off the map or inside a wall (mid-jump over the edge): leave everything unreached
+    if ((targetCell == -1) || (map->grid.cells[targetCell] != 0)) return;
+
+    int head = 0;
+    int tail = 0;
+    field->distance[targetCell] = 0;
+    field->queue[tail++] = targetCell;
+
+    const int offsetX[4] = { 1, -1, 0, 0 };
+    const int offsetZ[4] = { 0, 0, 1, -1 };
+
+    while (head < tail)
+    {
+        int cell = field->queue[head++];
+        int cellX = cell%field->width;
+        int cellZ = cell/field->width;
+
+        for (int k = 0; k < 4; k++)
+        {
+            int x = cellX + offsetX[k];
+            int z = cellZ + offsetZ[k];
+            if (x < 0 || z < 0 || x >= field->width || z >= field->height) continue;
+
+            int neighbour = z*field->width + x;
+            if ((map->grid.cells[neighbour] != 0) || (field->distance[neighbour] != FLOW_FIELD_UNREACHED)) continue;
+
+            field->distance[neighbour] = field->distance[cell] + 1;
+            field->queue[tail++] = neighbour;
+        }
+    }
+
+    // Only reached cells are in the queue, skip the target itself
+    for (int i = 1; i < tail; i++)
+    {
+        int cell = field->queue[i];
+        int cellX = cell%field->width;
+        int cellZ = cell/field->width;
+        int best = -1;
+        int bestDistance = field->distance[cell];
+
+        for (int z = -1; z <= 1; z++)
+        {
+            for (int x = -1; x <= 1; x++)
+            {
+                if ((x == 0) && (z == 0)) continue;
+                if (IsCollisionGridWall(&map->grid, cellX + x, cellZ) || IsCollisionGridWall(&map->grid, cellX, cellZ + z)) continue;
+                if (cellX + x < 0 || cellZ + z < 0 || cellX + x >= field->width || cellZ + z >= field->height) continue;
+
+                int neighbour = (cellZ + z)*field->width + cellX + x;
+                if (field->distance[neighbour] < bestDistance)
+                {
+                    best = neighbour;
+                    bestDistance = field->distance[neighbour];
+                }
+            }
+        }
+
+        field->next[cell] = best;
+    }
+}
+
+// Unit XZ direction to move along: towards the centre of the next cell on the path,
+// straight at the target once in its cell or anywhere the field doesn't reach
+Vector3 GetFlowFieldDirection(const FlowField *field, const MapCollision *map, Vector3 position, Vector3 target)
+{
+    int cell = GetFlowFieldCell(field, map, position);
+    int next = (cell != -1)? field->next[cell] : -1;
+
+    Vector3 goal = target;
+    if (next != -1) goal = (Vector3){ map->position.x + next%field->width, position.y, map->position.z + next/field->width };
+
+    Vector3 direction = { goal.x - position.x, 0.0f, goal.z - position.z };
+    float length = sqrtf(direction.x*direction.x + direction.z*direction.z);
+
+    return (length > 0.0f)? Vector3Scale(direction, 1.0f/length) : (Vector3){ 0.0f, 0.0f, 0.0f };
+}
+
+VisibilityGrid LoadVisibilityGrid(const MapCollision *map)
+{
+    VisibilityGrid visibility = { 0 };
+    visibility.width = map->grid.width;
+    visibility.height = map->grid.height;
+    visibility.viewerCell = -1;
+    visibility.visible = (unsigned char *)PushArena(&levelArena, visibility.width*visibility.height);
+
+    return visibility;
+}
+
+// Recast the view when the viewer moved to another cell, otherwise nothing to do
+// Recursive shadowcasting, one pass per octant around the viewer cell
+void UpdateVisibilityGrid(VisibilityGrid *visibility, const MapCollision *map, Vector3 viewer)
+{
+    int cellX, cellZ;
+    GetMapCell(map, viewer, &cellX, &cellZ);
+    int viewerCell = (cellX < 0 || cellZ < 0 || cellX >= visibility->width || cellZ >= visibility->height)? -1 : cellZ*visibility->width + cellX;
+    if ((viewerCell == visibility->viewerCell) && (viewerCell != -1)) return;
+    visibility->viewerCell = viewerCell;
+
+    memset(visibility->visible, 0, visibility->width*visibility->height);
+    if (viewerCell == -1) return;
+
+    visibility->visible[viewerCell] = 1;
+
+    // Transforms from octant space (row outwards, column across) to grid x and z
+    const int octants[8][4] = {
+        { 1, 0, 0, 1 }, { 0, 1, 1, 0 }, { 0, -1, 1, 0 }, { -1, 0, 0, 1 },
+        { -1, 0, 0, -1 }, { 0, -1, -1, 0 }, { 0, 1, -1, 0 }, { 1, 0, 0, -1 }
+    };
+
+    for (int octant = 0; octant < 8; octant++)
+    {
+        CastVisibilityOctant(visibility, map, 1, 1.0f, 0.0f, octants[octant][0], octants[octant][1], octants[octant][2], octants[octant][3]);
+    }
+}
+
+// Light one octant row by row between two slopes, a wall splits the light into the part
+// before it (recursed into) and the part after it (carried on here)
+void CastVisibilityOctant(VisibilityGrid *visibility, const MapCollision *map, int row, float startSlope, float endSlope, int xx, int xz, int zx, int zz)
+{
+    if (startSlope < endSlope) return;
+
+    int viewerX = visibility->viewerCell%visibility->width;
+    int viewerZ = visibility->viewerCell/visibility->width;
+    float nextStartSlope = startSlope;
+
+    for (int distance = row; distance <= VISIBILITY_RADIUS; distance++)
+    {
+        bool blocked = false;
+
+        for (int column = distance; column >= 0; column--)
+        {
+            // Slopes through the cell's far and near corners
+            float leftSlope = (column + 0.5f)/(distance - 0.5f);
+            float rightSlope = (column - 0.5f)/(distance + 0.5f);
+            if (startSlope < rightSlope) continue;
+            if (endSlope > leftSlope) break;
+
+            int x = viewerX + column*xx + distance*xz;
+            int z = viewerZ + column*zx + distance*zz;
+            bool inside = (x >= 0) && (z >= 0) && (x < visibility->width) && (z < visibility->height);
+
+            if (inside && (column*column + distance*distance <= VISIBILITY_RADIUS*VISIBILITY_RADIUS)) visibility->visible[z*visibility->width + x] = 1;
+
+            // The map edge blocks like a wall
+            bool wall = !inside || IsCollisionGridWall(&map->grid, x, z);
+            if (blocked)
+            {
+                if (wall) nextStartSlope = rightSlope;
+                else
+                {
+                    blocked = false;
+                    startSlope = nextStartSlope;
+                }
+            }
+            else if (wall && (distance < VISIBILITY_RADIUS))
+            {
+                blocked = true;
+                CastVisibilityOctant(visibility, map, distance + 1, startSlope, leftSlope, xx, xz, zx, zz);
+                nextStartSlope = rightSlope;
+            }
+        }
+
+        if (blocked) break;
+    }
+}
+
+// Check if the cell under a position is in view, false off the map
+bool IsVisibleFromViewer(const VisibilityGrid *visibility, const MapCollision *map, Vector3 position)
+{
+    int cellX, cellZ;
+    GetMapCell(map, position, &cellX, &cellZ);
+    if (cellX < 0 || cellZ < 0 || cellX >= visibility->width || cellZ >= visibility->height) return false;
+
+    return (visibility->visible[cellZ*visibility->width + cellX] != 0);
+}
+
+BulletRenderer LoadBulletRenderer(void)
+{
+    BulletRenderer renderer = { 0 };
+
+    // Unit sphere scaled by each bullet's radius, bullets are tiny on screen so a few rings are enough
+    renderer.mesh = GenMeshSphere(1.0f, 6, 8);
+    renderer.material = LoadMaterialDefault();
+
+    Shader shader = LoadShader(TextFormat("resources/shaders/glsl%i/bullet_instanced.vs", GLSL_VERSION),
+                               TextFormat("resources/shaders/glsl%i/bullet_instanced.fs", GLSL_VERSION));
+
+    // LoadShader() hands back the default shader on failure
+    if (shader.id != rlGetShaderIdDefault())
+    {
+        shader.locs[SHADER_LOC_MATRIX_MVP] = GetShaderLocation(shader, "mvp");
+        shader.locs[SHADER_LOC_MATRIX_MODEL] = GetShaderLocationAttrib(shader, "instanceTransform");
+        renderer.material.shader = shader;
+        renderer.instanced = true;
+    }
+    else TraceLog(LOG_WARNING, "BULLETS: Instancing shader not available, drawing bullets one by one");
+
+    return renderer;
+}
+
+void UnloadBulletRenderer(BulletRenderer renderer)
+{
+    UnloadMaterial(renderer.material);      // Also unloads the instancing shader, the default one is skipped
+    UnloadMesh(renderer.mesh);
+}
+
+// Draw all live bullets at their interpolated positions, one call per side
+// NOTE: Bullets outside the frustum are skipped, pass NULL to draw everything
+void DrawBullets(BulletRenderer *renderer, const BulletPool *pool, float alpha, const Frustum *frustum)
+{
+    if (pool->count == 0) return;
+
+    // Player bullets fill from the front, enemy bullets from the back
+    Matrix *transforms = (Matrix *)PushArena(&frameArena, pool->count*sizeof(Matrix));
+    int last = pool->count - 1;
+
+    // Partition by side while building transforms, player bullets from the front and enemy bullets from the back
+    int playerCount = 0;
+    int enemyCount = 0;
+
+    for (int i = 0; i < pool->count; i++)
+    {
+        float radius = pool->radius[i];
+        Vector3 position = {
+            Lerp(pool->previousX[i], pool->positionX[i], alpha),
+            Lerp(pool->previousY[i], pool->positionY[i], alpha),
+            Lerp(pool->previousZ[i], pool->positionZ[i], alpha)
+        };
+        if ((frustum != NULL) && !IsSphereInFrustum(frustum, position, radius)) continue;
+
+        Matrix transform = MatrixScale(radius, radius, radius);
+        transform.m12 = position.x;
+        transform.m13 = position.y;
+        transform.m14 = position.z;
+
+        if (pool->fromPlayer[i]) transforms[playerCount++] = transform;
+        else transforms[last - enemyCount++] = transform;
+    }
+
+    if (renderer->instanced)
+    {
+        renderer->material.maps[MATERIAL_MAP_DIFFUSE].color = PLAYER_BULLET_COLOR;
+        if (playerCount > 0) DrawMeshInstanced(renderer->mesh, renderer->material, transforms, playerCount);
+
+        renderer->material.maps[MATERIAL_MAP_DIFFUSE].color = ENEMY_BULLET_COLOR;
+        if (enemyCount > 0) DrawMeshInstanced(renderer->mesh, renderer->material, transforms + last + 1 - enemyCount, enemyCount);
+    }
+    else
+    {
+        // Still avoids regenerating sphere geometry every call like DrawSphere() does
+        renderer->material.maps[MATERIAL_MAP_DIFFUSE].color = PLAYER_BULLET_COLOR;
+        for (int i = 0; i < playerCount; i++) DrawMesh(renderer->mesh, renderer->material, transforms[i]);
+
+        renderer->material.maps[MATERIAL_MAP_DIFFUSE].color = ENEMY_BULLET_COLOR;
+        for (int i = last + 1 - enemyCount; i <= last; i++) DrawMesh(renderer->mesh, renderer->material, transforms[i]);
+    }
+}
+
+SpriteBatch LoadSpriteBatch(void)
+{
+    SpriteBatch batch = { 0 };
+    batch.capacity = 2*ENEMY_POOL_CAPACITY + 1;     // Every enemy and its health bar, plus the player
+
+    return batch;
+}
+
+// Start a new batch, must be called inside BeginMode3D()
+void BeginSpriteBatch(SpriteBatch *batch, Camera camera)
+{
+    Matrix view = MatrixLookAt(camera.position, camera.target, camera.up);
+
+    batch->sprites = (Sprite *)PushArena(&frameArena, batch->capacity*sizeof(Sprite));
+    batch->count = 0;
+    batch->right = (Vector3){ view.m0, view.m4, view.m8 };
+    batch->up = (Vector3){ 0.0f, 1.0f, 0.0f };        // Same upright billboards as DrawBillboard()
+}
+
+// Queue an atlas region as a billboard centred on position, size is the height in world units
+void AddSpriteBillboard(SpriteBatch *batch, const TextureAtlas *atlas, AtlasRegionId region, Vector3 position, float size, Color tint)
+{
+    Rectangle rect = atlas->regions[region];
+    float aspect = (rect.height > 0.0f)? rect.width/rect.height : 1.0f;
+    *PushSprite(batch) = (Sprite){ atlas->texture.id, GetAtlasTexCoords(atlas, region), position, (Vector2){ size*aspect, size }, tint };
+}
+
+// Queue a flat coloured quad from the atlas white block, so it lands in the same draw as the billboards
+void AddSpriteQuad(SpriteBatch *batch, const TextureAtlas *atlas, Vector3 position, Vector2 size, Color color)
+{
+    *PushSprite(batch) = (Sprite){ atlas->texture.id, GetAtlasTexCoords(atlas, ATLAS_REGION_WHITE), position, size, color };
+}
+
+// Reserve the next sprite, doubling the queue when it's full
+Sprite *PushSprite(SpriteBatch *batch)
+{
+    if (batch->count >= batch->capacity)
+    {
+        Sprite *sprites = (Sprite *)PushArena(&frameArena, 2*batch->capacity*sizeof(Sprite));
+        memcpy(sprites, batch->sprites, batch->count*sizeof(Sprite));
+        batch->sprites = sprites;
+        batch->capacity *= 2;
+    }
+
+    return &batch->sprites[batch->count++];
+}
+
+// Emit queued quads through the rlgl batch, one texture group at a time
+void EndSpriteBatch(SpriteBatch *batch)
+{
+    int start = 0;
+
+    while (start < batch->count)
+    {
+        // Swap every sprite sharing the first remaining texture to the front of the range
+        unsigned int textureId = batch->sprites[start].textureId;
+        int end = start + 1;
+        for (int i = start + 1; i < batch->count; i++)
+        {
+            if (batch->sprites[i].textureId == textureId)
+            {
+                Sprite temp = batch->sprites[end];
+                batch->sprites[end++] = batch->sprites[i];
+                batch->sprites[i] = temp;
+            }
+        }
+
+        rlSetTexture(textureId);
+        rlBegin(RL_QUADS);
+
+            for (int i = start; i < end; i++)
+            {
+                const Sprite *sprite = &batch->sprites[i];
+                Vector3 right = Vector3Scale(batch->right, sprite->size.x*0.5f);
+                Vector3 up = Vector3Scale(batch->up, sprite->size.y*0.5f);
+
+                Vector3 bottomLeft = Vector3Subtract(Vector3Subtract(sprite->position, right), up);
+                Vector3 bottomRight = Vector3Subtract(Vector3Add(sprite->position, right), up);
+                Vector3 topRight = Vector3Add(Vector3Add(sprite->position, right), up);
+                Vector3 topLeft = Vector3Add(Vector3Subtract(sprite->position, right), up);
+
+                float u0 = sprite->source.x;
+                float v0 = sprite->source.y;
+                float u1 = sprite->source.x + sprite->source.width;
+                float v1 = sprite->source.y + sprite->source.height;
+
+                rlColor4ub(sprite->tint.r, sprite->tint.g, sprite->tint.b, sprite->tint.a);
+                rlTexCoord2f(u0, v1); rlVertex3f(bottomLeft.x, bottomLeft.y, bottomLeft.z);
+                rlTexCoord2f(u1, v1); rlVertex3f(bottomRight.x, bottomRight.y, bottomRight.z);
+                rlTexCoord2f(u1, v0); rlVertex3f(topRight.x, topRight.y, topRight.z);
+                rlTexCoord2f(u0, v0); rlVertex3f(topLeft.x, topLeft.y, topLeft.z);
+            }
+
+        rlEnd();
+        rlSetTexture(0);
+
+        start = end;
+    }
+
+    batch->count = 0;
+}
+
+// Pack the sprites, a white block and the HUD font glyphs into one page
+// Sprite images come from the bundle when it has them, the font is rasterized from font.ttf
+TextureAtlas LoadTextureAtlas(const AssetBundle *bundle)
+{
+    TextureAtlas atlas = { 0 };
+    Image images[ATLAS_REGION_COUNT] = { 0 };
+
+    images[ATLAS_REGION_PLAYER] = LoadBundleImage(bundle, BUNDLE_IMAGE_PLAYER, "resources/player.png");
+    images[ATLAS_REGION_ENEMY] = LoadBundleImage(bundle, BUNDLE_IMAGE_ENEMY, "resources/enemy.png");
+    images[ATLAS_REGION_WHITE] = GenImageColor(4, 4, WHITE);
+
+    for (int i = ATLAS_REGION_PLAYER; i <= ATLAS_REGION_ENEMY; i++)
+    {
+        if ((images[i].data != NULL) && (images[i].height > ATLAS_SPRITE_HEIGHT))
+        {
+            int width = images[i].width*ATLAS_SPRITE_HEIGHT/images[i].height;
+            ImageResize(&images[i], (width > 0)? width : 1, ATLAS_SPRITE_HEIGHT);
+        }
+    }
+
+    // Same glyph set and padding LoadFontEx() would use, only the page it lands on is ours
+    int fileSize = 0;
+    unsigned char *fileData = LoadFileData("resources/font.ttf", &fileSize);
+    if (fileData != NULL)
+    {
+        atlas.font.glyphs = LoadFontData(fileData, fileSize, HUD_FONT_SIZE, NULL, HUD_FONT_GLYPHS, FONT_DEFAULT);
+        UnloadFileData(fileData);
+    }
+
+    if (atlas.font.glyphs != NULL)
+    {
+        atlas.font.baseSize = HUD_FONT_SIZE;
+        atlas.font.glyphCount = HUD_FONT_GLYPHS;
+        atlas.font.glyphPadding = 4;
+        images[ATLAS_REGION_FONT] = GenImageFontAtlas(atlas.font.glyphs, &atlas.font.recs, HUD_FONT_GLYPHS, HUD_FONT_SIZE, atlas.font.glyphPadding, 0);
+    }
+
+    Image page = GenImageAtlas(images, ATLAS_REGION_COUNT, atlas.regions);
+    atlas.texture = LoadTextureFromImage(page);
+    UnloadImage(page);
+    for (int i = 0; i < ATLAS_REGION_COUNT; i++) UnloadImage(images[i]);
+
+    // Sample the white block away from its edges, so filtering never pulls in the padding
+    Rectangle *white = &atlas.regions[ATLAS_REGION_WHITE];
+    *white = (Rectangle){ white->x + 1.0f, white->y + 1.0f, white->width - 2.0f, white->height - 2.0f };
+
+    // If enemy texture not found, use the player's instead
+    if (atlas.regions[ATLAS_REGION_ENEMY].width == 0.0f) atlas.regions[ATLAS_REGION_ENEMY] = atlas.regions[ATLAS_REGION_PLAYER];
+
+    if (atlas.font.glyphs != NULL)
+    {
+        // Glyph rects were laid out on the font's own page, move them to where that page was packed
+        for (int i = 0; i < atlas.font.glyphCount; i++)
+        {
+            atlas.font.recs[i].x += atlas.regions[ATLAS_REGION_FONT].x;
+            atlas.font.recs[i].y += atlas.regions[ATLAS_REGION_FONT].y;
+        }
+        atlas.font.texture = atlas.texture;
+    }
+    else atlas.font = GetFontDefault();
+
+    return atlas;
+}
+
+void UnloadTextureAtlas(TextureAtlas atlas)
+{
+    // The font shares the page, only its glyph data is ours to free
+    if (atlas.font.recs != GetFontDefault().recs)
+    {
+        UnloadFontData(atlas.font.glyphs, atlas.font.glyphCount);
+        MemFree(atlas.font.recs);
+    }
+
+    UnloadTexture(atlas.texture);
+}
+
+// Shelf-pack images into one RGBA page, tallest first, and return the texel rect of each
+// Images without data get an empty rect, the others are converted to RGBA in place
+Image GenImageAtlas(Image *images, int count, Rectangle *regions)
+{
+    int *order = (int *)PushArena(&frameArena, count*sizeof(int));
+    int orderCount = 0;
+    int pageWidth = ATLAS_PAGE_WIDTH;
+
+    for (int i = 0; i < count; i++)
+    {
+        regions[i] = (Rectangle){ 0 };
+        if (images[i].data == NULL) continue;
+
+        // Insertion sort by height, there are only a handful of images
+        int j = orderCount++;
+        while ((j > 0) && (images[order[j - 1]].height < images[i].height))
+        {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+
+        while (images[i].width + 2*ATLAS_PADDING > pageWidth) pageWidth *= 2;
+    }
+
+    int x = 0;
+    int y = 0;
+    int shelfHeight = 0;
+    for (int k = 0; k < orderCount; k++)
+    {
+        const Image *image = &images[order[k]];
+        int width = image->width + 2*ATLAS_PADDING;
+        int height = image->height + 2*ATLAS_PADDING;
+
+        if (x + width > pageWidth)
+        {
+            x = 0;
+            y += shelfHeight;
+            shelfHeight = 0;
+        }
+
+        regions[order[k]] = (Rectangle){ (float)(x + ATLAS_PADDING), (float)(y + ATLAS_PADDING), (float)image->width, (float)image->height };
+        x += width;
+        if (height > shelfHeight) shelfHeight = height;
+    }
+
+    int pageHeight = 1;
+    while (pageHeight < y + shelfHeight) pageHeight *= 2;
+
+    Image page = GenImageColor(pageWidth, pageHeight, BLANK);
+    Color *pixels = (Color *)page.data;
+
+    for (int k = 0; k < orderCount; k++)
+    {
+        Image *image = &images[order[k]];
+        ImageFormat(image, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+
+        const Color *source = (const Color *)image->data;
+        int left = (int)regions[order[k]].x;
+        int top = (int)regions[order[k]].y;
+        for (int row = 0; row < image->height; row++)
+        {
+            memcpy(&pixels[(top + row)*pageWidth + left], &source[row*image->width], image->width*sizeof(Color));
+        }
+    }
+
+    return page;
+}
+
+// Normalized texture coordinates of a region, as the sprite batch feeds them to rlgl
+Rectangle GetAtlasTexCoords(const TextureAtlas *atlas, AtlasRegionId region)
+{
+    if ((atlas->texture.width <= 0) || (atlas->texture.height <= 0)) return (Rectangle){ 0 };
+
+    Rectangle rect = atlas->regions[region];
+    float width = (float)atlas->texture.width;
+    float height = (float)atlas->texture.height;
+
+    return (Rectangle){ rect.x/width, rect.y/height, rect.width/width, rect.height/height };
+}
+
+// Owned copy of a bundle image, or the decoded source file when the bundle doesn't have it
+Image LoadBundleImage(const AssetBundle *bundle, BundleImageId image, const char *fileName)
+{
+    if (bundle->images[image].data != NULL) return ImageCopy(bundle->images[image]);
+
+    return LoadImage(fileName);
+}
+
+// Width of HUD text in the atlas font, sized and spaced like DrawText() so existing layouts carry over
+int MeasureHudText(const TextureAtlas *atlas, const char *text, int fontSize)
+{
+    return (int)MeasureTextEx(atlas->font, text, (float)fontSize, (float)(fontSize/10)).x;
+}
+
+// Lay out a label the way DrawTextEx() places glyphs, skipped when nothing that affects the layout changed
+// NOTE: Single line and ASCII only, which is all the HUD shows
+void SetHudText(HudText *label, const TextureAtlas *atlas, const char *text, int posX, int posY, int fontSize, Color color)
+{
+    label->color = color;
+    if ((label->posX == posX) && (label->posY == posY) && (label->fontSize == fontSize) && (strcmp(label->text, text) == 0)) return;
+
+    strncpy(label->text, text, HUD_TEXT_LENGTH - 1);
+    label->text[HUD_TEXT_LENGTH - 1] = '\0';
+    label->posX = posX;
+    label->posY = posY;
+    label->fontSize = fontSize;
+    label->glyphCount = 0;
+
+    const Font *font = &atlas->font;
+    if ((font->texture.width <= 0) || (font->texture.height <= 0) || (font->baseSize <= 0)) return;
+
+    float scale = (float)fontSize/font->baseSize;
+    float spacing = (float)(fontSize/10);
+    float padding = (float)font->glyphPadding;
+    float offsetX = 0.0f;
+
+    for (int i = 0; label->text[i] != '\0'; i++)
+    {
+        int codepoint = (unsigned char)label->text[i];
+        int index = GetGlyphIndex(*font, codepoint);
+        Rectangle rec = font->recs[index];
+
+        if ((codepoint != ' ') && (codepoint != '\t'))
+        {
+            HudGlyph *glyph = &label->glyphs[label->glyphCount++];
+            glyph->source = (Rectangle){ (rec.x - padding)/font->texture.width, (rec.y - padding)/font->texture.height,
+                (rec.width + 2.0f*padding)/font->texture.width, (rec.height + 2.0f*padding)/font->texture.height };
+            glyph->dest = (Rectangle){ posX + offsetX + (font->glyphs[index].offsetX - padding)*scale,
+                posY + (font->glyphs[index].offsetY - padding)*scale, (rec.width + 2.0f*padding)*scale, (rec.height + 2.0f*padding)*scale };
+        }
+
+        if (font->glyphs[index].advanceX == 0) offsetX += rec.width*scale + spacing;
+        else offsetX += font->glyphs[index].advanceX*scale + spacing;
+    }
+}
+
+// Refresh the labels whose values changed since the last frame, everything else keeps its layout
+void UpdateHudLayer(HudLayer *hud, const TextureAtlas *atlas, const GameWorld *world, int floor, bool recording, int screenWidth, int screenHeight)
+{
+    const Archetype *players = &world->archetypes[ARCHETYPE_PLAYER];
+    Vector3 position = players->transforms[0].position;
+    Vector3 velocity = players->velocities[0].velocity;
+    int fps = GetFPS();
+    int banner = (world->state == GAME_OVER)? 2 : (world->state == GAME_PAUSED)? 1 : 0;
+
+    if (!hud->ready)
+    {
+        SetHudText(&hud->labels[HUD_LABEL_HEALTH], atlas, "HEALTH:", 10, 80, 20, WHITE);
+        SetHudText(&hud->labels[HUD_LABEL_HELP_MOVE], atlas, "Controls: WASD to move, SPACE to jump, Mouse wheel to zoom", 10, screenHeight - 70, 20, WHITE);
+        SetHudText(&hud->labels[HUD_LABEL_HELP_SHOOT], atlas, "Left-click to shoot, P to pause, F to toggle wireframe", 10, screenHeight - 50, 20, WHITE);
+    }
+
+    // Same colours as DrawFPS()
+    if (!hud->ready || (fps != hud->fps))
+    {
+        SetHudText(&hud->labels[HUD_LABEL_FPS], atlas, TextFormat("%2i FPS", fps), 10, 10, 20, (fps < 15)? RED : (fps < 30)? ORANGE : LIME);
+    }
+
+    // Bitwise compare: any change at all may show up in the printed digits
+    if (!hud->ready || (memcmp(&position, &hud->position, sizeof(Vector3)) != 0))
+    {
+        SetHudText(&hud->labels[HUD_LABEL_POSITION], atlas, TextFormat("Position: (%.2f, %.2f, %.2f)", position.x, position.y, position.z), 10, 30, 20, YELLOW);
+    }
+
+    if (!hud->ready || (memcmp(&velocity, &hud->velocity, sizeof(Vector3)) != 0))
+    {
+        SetHudText(&hud->labels[HUD_LABEL_VELOCITY], atlas, TextFormat("Velocity: (%.2f, %.2f, %.2f)", velocity.x, velocity.y, velocity.z), 10, 50, 20, YELLOW);
+    }
+
+    if (!hud->ready || (floor != hud->floor))
+    {
+        SetHudText(&hud->labels[HUD_LABEL_FLOOR], atlas, (floor > 0)? TextFormat("FLOOR %i", floor) : "", 210, 80, 20, WHITE);
+    }
+
+    if (!hud->ready || (recording != hud->recording))
+    {
+        SetHudText(&hud->labels[HUD_LABEL_HELP_DEBUG], atlas, TextFormat("F3 to toggle profiler, F4 to %s timings CSV", recording? "stop" : "record"), 10, screenHeight - 30, 20, WHITE);
+    }
+
+    if (!hud->ready || (banner != hud->banner))
+    {
+        const char *title = (banner == 2)? "GAME OVER" : (banner == 1)? "GAME PAUSED" : "";
+        const char *hint = (banner == 2)? "PRESS R TO RESTART OR ESC TO QUIT" : (banner == 1)? "PRESS P TO RESUME" : "";
+
+        SetHudText(&hud->labels[HUD_LABEL_BANNER], atlas, title, screenWidth/2 - MeasureHudText(atlas, title, 40)/2, screenHeight/2 - 40, 40, (banner == 2)? RED : WHITE);
+        SetHudText(&hud->labels[HUD_LABEL_BANNER_HINT], atlas, hint, screenWidth/2 - MeasureHudText(atlas, hint, 20)/2, screenHeight/2 + 10, 20, WHITE);
+    }
+
+    hud->ready = true;
+    hud->fps = fps;
+    hud->position = position;
+    hud->velocity = velocity;
+    hud->floor = floor;
+    hud->recording = recording;
+    hud->banner = banner;
+}
+
+// Emit the cached glyph quads of labels [first, last) as one quad run on the font page
+void DrawHudLabels(const HudLayer *hud, const TextureAtlas *atlas, int first, int last)
+{
+    rlSetTexture(atlas->font.texture.id);
+    rlBegin(RL_QUADS);
+
+        rlNormal3f(0.0f, 0.0f, 1.0f);
+
+        for (int i = first; i < last; i++)
+        {
+            const HudText *label = &hud->labels[i];
+            rlColor4ub(label->color.r, label->color.g, label->color.b, label->color.a);
+
+            for (int j = 0; j < label->glyphCount; j++)
+            {
+                const Rectangle *source = &label->glyphs[j].source;
+                const Rectangle *dest = &label->glyphs[j].dest;
+
+                rlTexCoord2f(source->x, source->y); rlVertex2f(dest->x, dest->y);
+                rlTexCoord2f(source->x, source->y + source->height); rlVertex2f(dest->x, dest->y + dest->height);
+                rlTexCoord2f(source->x + source->width, source->y + source->height); rlVertex2f(dest->x + dest->width, dest->y + dest->height);
+                rlTexCoord2f(source->x + source->width, source->y); rlVertex2f(dest->x + dest->width, dest->y);
+            }
+        }
+
+    rlEnd();
+    rlSetTexture(0);
+}
+
+// Render the walls once at minimap scale, 4 pixels per cell unless the floor is too big to fit
+Minimap LoadMinimap(Texture2D cubicmap, int screenWidth)
+{
+    Minimap minimap = { 0 };
+
+    // Whole pixels per cell on small maps, large floors are scaled down to the same 200 pixels
+    int largest = (cubicmap.width > cubicmap.height)? cubicmap.width : cubicmap.height;
+    minimap.scale = (largest > 0)? 200.0f/largest : 1.0f;
+    if (minimap.scale > 1.0f) minimap.scale = floorf(minimap.scale);
+    if (minimap.scale > 4.0f) minimap.scale = 4.0f;
+
+    int width = (int)(cubicmap.width*minimap.scale);
+    int height = (int)(cubicmap.height*minimap.scale);
+    minimap.position = (Vector2){ (float)(screenWidth - width - 20), 20.0f };
+    minimap.target = LoadRenderTexture(width, height);
+
+    BeginTextureMode(minimap.target);
+        ClearBackground(BLANK);
+        DrawTextureEx(cubicmap, (Vector2){ 0.0f, 0.0f }, 0.0f, minimap.scale, WHITE);
+        DrawRectangleLinesEx((Rectangle){ 0.0f, 0.0f, (float)width, (float)height }, 1.0f, GREEN);
+    EndTextureMode();
+
+    return minimap;
+}
+
+void UnloadMinimap(Minimap minimap)
+{
+    UnloadRenderTexture(minimap.target);
+}
+
+// Cached walls, then the player and every enemy as quads in a single run on the atlas white block
+// NOTE: Markers use the simulated positions, a cell is scale pixels from the map origin
+void DrawMinimap(const Minimap *minimap, const TextureAtlas *atlas, const GameWorld *world, Vector3 mapPosition)
+{
+    // Render textures are stored upside down, flip the source rect
+    Texture2D texture = minimap->target.texture;
+    DrawTextureRec(texture, (Rectangle){ 0.0f, 0.0f, (float)texture.width, (float)-texture.height }, minimap->position, WHITE);
+
+    Rectangle white = GetAtlasTexCoords(atlas, ATLAS_REGION_WHITE);
+    float u = white.x + white.width*0.5f;
+    float v = white.y + white.height*0.5f;
+
+    // Same pixel snapping the markers always had
+    #define MINIMAP_MARKER(p, size, color) { \
+        float left = minimap->position.x + (int)(((p).x - mapPosition.x)*minimap->scale); \
+        float top = minimap->position.y + (int)(((p).z - mapPosition.z)*minimap->scale); \
+        rlColor4ub((color).r, (color).g, (color).b, (color).a); \
+        rlTexCoord2f(u, v); rlVertex2f(left, top); \
+        rlTexCoord2f(u, v); rlVertex2f(left, top + (size)); \
+        rlTexCoord2f(u, v); rlVertex2f(left + (size), top + (size)); \
+        rlTexCoord2f(u, v); rlVertex2f(left + (size), top); \
+    }
+
+    const Archetype *players = &world->archetypes[ARCHETYPE_PLAYER];
+    const Archetype *enemies = &world->archetypes[ARCHETYPE_ENEMY];
+
+    rlSetTexture(atlas->texture.id);
+    rlBegin(RL_QUADS);
+
+        rlNormal3f(0.0f, 0.0f, 1.0f);
+        MINIMAP_MARKER(players->transforms[0].position, 4.0f, RED);
+        for (int i = 0; i < enemies->count; i++) MINIMAP_MARKER(enemies->transforms[i].position, 3.0f, PURPLE);
+
+    rlEnd();
+    rlSetTexture(0);
+
+    #undef MINIMAP_MARKER
+}
+
+// Build the render mesh of a rectangle of cells straight from the collision grid, laid out like
+// GenMeshCubicmap() with a cube size of 1 and mapped to the same 2x2 atlas
+// Faces between neighbouring walls are skipped across chunk edges too, and the roof over open
+// cells is left out since the camera never looks up
+// NOTE: CPU-side only so it can run on a worker thread, call UploadMesh() before drawing
+Mesh GenMeshMapChunk(const CollisionGrid *grid, int cellX, int cellZ, int width, int height)
+{
+    Mesh mesh = { 0 };
+
+    // Atlas regions: wall sides on the top row, wall tops and floor on the bottom row
+    const Rectangle sideUV = { 0.0f, 0.0f, 0.5f, 0.5f };
+    const Rectangle topUV = { 0.0f, 0.5f, 0.5f, 0.5f };
+    const Rectangle floorUV = { 0.5f, 0.5f, 0.5f, 0.5f };
+
+    // Count quads first so the buffers are allocated once
+    int quadCount = 0;
+    for (int z = cellZ; z < cellZ + height; z++)
+    {
+        for (int x = cellX; x < cellX + width; x++)
+        {
+            if (!IsCollisionGridWall(grid, x, z)) quadCount++;
+            else
+            {
+                quadCount++;
+                if (!IsCollisionGridWall(grid, x, z + 1)) quadCount++;
+                if (!IsCollisionGridWall(grid, x, z - 1)) quadCount++;
+                if (!IsCollisionGridWall(grid, x + 1, z)) quadCount++;
+                if (!IsCollisionGridWall(grid, x - 1, z)) quadCount++;
+            }
+        }
+    }
+
+    mesh.vertexCount = quadCount*6;
+    mesh.triangleCount = quadCount*2;
+    mesh.vertices = (float *)MemAlloc(mesh.vertexCount*3*sizeof(float));
+    mesh.texcoords = (float *)MemAlloc(mesh.vertexCount*2*sizeof(float));
+    mesh.normals = (float *)MemAlloc(mesh.vertexCount*3*sizeof(float));
+
+    int vertex = 0;
+
+    // Quad corners are given counter-clockwise as seen from outside, starting top-left of the texture
+    #define MAP_CHUNK_QUAD(tl, bl, br, tr, normal, uv) do { \
+        Vector3 corners[6] = { tl, bl, br, tl, br, tr }; \
+        Vector2 coords[6] = { \
+            { uv.x, uv.y }, { uv.x, uv.y + uv.height }, { uv.x + uv.width, uv.y + uv.height }, \
+            { uv.x, uv.y }, { uv.x + uv.width, uv.y + uv.height }, { uv.x + uv.width, uv.y } }; \
+        for (int k = 0; k < 6; k++, vertex++) { \
+            mesh.vertices[vertex*3] = corners[k].x; \
+            mesh.vertices[vertex*3 + 1] = corners[k].y; \
+            mesh.vertices[vertex*3 + 2] = corners[k].z; \
+            mesh.texcoords[vertex*2] = coords[k].x; \
+            mesh.texcoords[vertex*2 + 1] = coords[k].y; \
+            mesh.normals[vertex*3] = normal.x; \
+            mesh.normals[vertex*3 + 1] = normal.y; \
+            mesh.normals[vertex*3 + 2] = normal.z; \
+        } \
+    } while (0)
+
+    for (int z = cellZ; z < cellZ + height; z++)
+    {
+        for (int x = cellX; x < cellX + width; x++)
+        {
+            // Cell centre relative to the chunk origin
+            float cx = (float)(x - cellX);
+            float cz = (float)(z - cellZ);
+
+            // Cube corners: top ring n*, bottom ring s*; w/e along x, n/s along z
+            Vector3 topNW = { cx - 0.5f, 1.0f, cz - 0.5f };
+            Vector3 topSW = { cx - 0.5f, 1.0f, cz + 0.5f };
+            Vector3 topSE = { cx + 0.5f, 1.0f, cz + 0.5f };
+            Vector3 topNE = { cx + 0.5f, 1.0f, cz - 0.5f };
+            Vector3 lowNW = { cx - 0.5f, 0.0f, cz - 0.5f };
+            Vector3 lowSW = { cx - 0.5f, 0.0f, cz + 0.5f };
+            Vector3 lowSE = { cx + 0.5f, 0.0f, cz + 0.5f };
+            Vector3 lowNE = { cx + 0.5f, 0.0f, cz - 0.5f };
+
+            if (!IsCollisionGridWall(grid, x, z))
+            {
+                MAP_CHUNK_QUAD(lowNW, lowSW, lowSE, lowNE, ((Vector3){ 0.0f, 1.0f, 0.0f }), floorUV);
+                continue;
+            }
+
+            MAP_CHUNK_QUAD(topNW, topSW, topSE, topNE, ((Vector3){ 0.0f, 1.0f, 0.0f }), topUV);
+            if (!IsCollisionGridWall(grid, x, z + 1)) MAP_CHUNK_QUAD(topSW, lowSW, lowSE, topSE, ((Vector3){ 0.0f, 0.0f, 1.0f }), sideUV);
+            if (!IsCollisionGridWall(grid, x, z - 1)) MAP_CHUNK_QUAD(topNE, lowNE, lowNW, topNW, ((Vector3){ 0.0f, 0.0f, -1.0f }), sideUV);
+            if (!IsCollisionGridWall(grid, x + 1, z)) MAP_CHUNK_QUAD(topSE, lowSE, lowNE, topNE, ((Vector3){ 1.0f, 0.0f, 0.0f }), sideUV);
+            if (!IsCollisionGridWall(grid, x - 1, z)) MAP_CHUNK_QUAD(topNW, lowNW, lowSW, topSW, ((Vector3){ -1.0f, 0.0f, 0.0f }), sideUV);
+        }
+    }
+
+    #undef MAP_CHUNK_QUAD
+
+    return mesh;
+}
+
+// Chunk geometry only depends on the collision grid, so this is safe to call from the worker
+// Baked meshes are copied rather than referenced, so every chunk unloads the same way
+void BuildWorldChunk(const MapCollision *map, const AssetBundle *bundle, int chunkX, int chunkZ, Mesh *mesh, MapWireframe *wireframe)
+{
+    int cellX = chunkX*MAP_CHUNK_SIZE;
+    int cellZ = chunkZ*MAP_CHUNK_SIZE;
+    int width = (map->grid.width - cellX < MAP_CHUNK_SIZE)? map->grid.width - cellX : MAP_CHUNK_SIZE;
+    int height = (map->grid.height - cellZ < MAP_CHUNK_SIZE)? map->grid.height - cellZ : MAP_CHUNK_SIZE;
+
+    if (bundle != NULL)
+    {
+        const BundleMesh *baked = &bundle->chunks[chunkZ*bundle->chunksX + chunkX];
+
+        *mesh = (Mesh){ 0 };
+        mesh->vertexCount = baked->vertexCount;
+        mesh->triangleCount = baked->vertexCount/3;
+        mesh->vertices = (float *)MemAlloc(mesh->vertexCount*3*sizeof(float));
+        mesh->texcoords = (float *)MemAlloc(mesh->vertexCount*2*sizeof(float));
+        mesh->normals = (float *)MemAlloc(mesh->vertexCount*3*sizeof(float));
+        memcpy(mesh->vertices, baked->vertices, mesh->vertexCount*3*sizeof(float));
+        memcpy(mesh->texcoords, baked->texcoords, mesh->vertexCount*2*sizeof(float));
+        memcpy(mesh->normals, baked->normals, mesh->vertexCount*3*sizeof(float));
+    }
+    else *mesh = GenMeshMapChunk(&map->grid, cellX, cellZ, width, height);
+
+    *wireframe = LoadMapWireframe(map, cellX, cellZ, width, height);
+}
+
+void InitWorldStream(WorldStream *stream, const MapCollision *map, const AssetBundle *bundle, Texture2D texture)
+{
+    memset(stream, 0, sizeof(WorldStream));
+
+    stream->map = map;
+    stream->chunksX = (map->grid.width + MAP_CHUNK_SIZE - 1)/MAP_CHUNK_SIZE;
+    stream->chunksZ = (map->grid.height + MAP_CHUNK_SIZE - 1)/MAP_CHUNK_SIZE;
+
+    // Baked meshes are only used when they were cut from this exact grid, generated floors never match
+    if ((bundle != NULL) && (bundle->chunks != NULL) &&
+        (bundle->grid.width == map->grid.width) && (bundle->grid.height == map->grid.height) &&
+        (memcmp(bundle->grid.cells, map->grid.cells, map->grid.width*map->grid.height) == 0)) stream->bundle = bundle;
+
+    stream->material = LoadMaterialDefault();
+    stream->material.maps[MATERIAL_MAP_DIFFUSE].texture = texture;
+
+#if defined(WORLD_STREAM_THREADED)
+    pthread_mutex_init(&stream->mutex, NULL);
+    pthread_cond_init(&stream->wake, NULL);
+    pthread_create(&stream->thread, NULL, WorldStreamWorker, stream);
+#endif
+}
+
+void CloseWorldStream(WorldStream *stream)
+{
+#if defined(WORLD_STREAM_THREADED)
+    pthread_mutex_lock(&stream->mutex);
+    stream->quit = true;
+    pthread_cond_signal(&stream->wake);
+    pthread_mutex_unlock(&stream->mutex);
+
+    pthread_join(stream->thread, NULL);
+    pthread_cond_destroy(&stream->wake);
+    pthread_mutex_destroy(&stream->mutex);
+#endif
+
+    for (int i = 0; i < WORLD_STREAM_SLOTS; i++)
+    {
+        WorldChunk *chunk = &stream->slots[i];
+        if ((chunk->state == CHUNK_BUILT) || (chunk->state == CHUNK_READY))
+        {
+            UnloadMesh(chunk->mesh);
+            UnloadMapWireframe(chunk->wireframe);
+        }
+    }
+
+    // Texture belongs to the caller, only free the maps like UnloadModel() does
+    RL_FREE(stream->material.maps);
+}
+
+// Point a slot at another chunk, dropping whatever it held
+// NOTE: Called with the mutex held
+void AssignWorldChunk(WorldStream *stream, int slot, int chunkX, int chunkZ)
+{
+    WorldChunk *chunk = &stream->slots[slot];
+
+    if ((chunk->state == CHUNK_BUILT) || (chunk->state == CHUNK_READY))
+    {
+        UnloadMesh(chunk->mesh);        // Fine for meshes never uploaded, GPU handles are zero
+        UnloadMapWireframe(chunk->wireframe);
+    }
+    chunk->mesh = (Mesh){ 0 };
+    chunk->wireframe = (MapWireframe){ 0 };
+    chunk->drawable = false;
+
+    chunk->chunkX = chunkX;
+    chunk->chunkZ = chunkZ;
+    chunk->generation++;
+
+    if ((chunkX < 0) || (chunkZ < 0) || (chunkX >= stream->chunksX) || (chunkZ >= stream->chunksZ))
+    {
+        chunk->state = CHUNK_EMPTY;
+        return;
+    }
+
+    // Cells are centred on integer offsets, same as the map collision boxes
+    const MapCollision *map = stream->map;
+    int width = (map->grid.width - chunkX*MAP_CHUNK_SIZE < MAP_CHUNK_SIZE)? map->grid.width - chunkX*MAP_CHUNK_SIZE : MAP_CHUNK_SIZE;
+    int height = (map->grid.height - chunkZ*MAP_CHUNK_SIZE < MAP_CHUNK_SIZE)? map->grid.height - chunkZ*MAP_CHUNK_SIZE : MAP_CHUNK_SIZE;
+    Vector3 offset = { map->position.x + chunkX*MAP_CHUNK_SIZE, map->position.y, map->position.z + chunkZ*MAP_CHUNK_SIZE };
+
+    chunk->transform = MatrixTranslate(offset.x, offset.y, offset.z);
+    chunk->bounds = (BoundingBox){
+        (Vector3){ offset.x - 0.5f, offset.y, offset.z - 0.5f },
+        (Vector3){ offset.x + width - 0.5f, offset.y + 1.0f, offset.z + height - 0.5f }
+    };
+    chunk->state = CHUNK_QUEUED;
+
+    if (!chunk->inQueue)
+    {
+        stream->jobs[(stream->jobHead + stream->jobCount)%WORLD_STREAM_SLOTS] = slot;
+        stream->jobCount++;
+        chunk->inQueue = true;
+    }
+}
+
+// Recentre the window on the focus chunk and upload chunks the worker finished
+// Chunks are queued nearest ring first, so the ground under the player shows up first
+void UpdateWorldStream(WorldStream *stream, Vector3 focus)
+{
+    const MapCollision *map = stream->map;
+    int centerX = (int)floorf((focus.x - map->bounds.min.x)/MAP_CHUNK_SIZE);
+    int centerZ = (int)floorf((focus.z - map->bounds.min.z)/MAP_CHUNK_SIZE);
+
+#if defined(WORLD_STREAM_THREADED)
+    pthread_mutex_lock(&stream->mutex);
+#endif
+
+    if (!stream->centered || (centerX != stream->centerX) || (centerZ != stream->centerZ))
+    {
+        for (int ring = 0; ring <= WORLD_STREAM_RADIUS; ring++)
+        {
+            for (int dz = -ring; dz <= ring; dz++)
+            {
+                for (int dx = -ring; dx <= ring; dx++)
+                {
+                    if ((abs(dx) != ring) && (abs(dz) != ring)) continue;
+
+                    int chunkX = centerX + dx;
+                    int chunkZ = centerZ + dz;
+                    int slot = (((chunkZ%WORLD_STREAM_SIDE) + WORLD_STREAM_SIDE)%WORLD_STREAM_SIDE)*WORLD_STREAM_SIDE +
+                               ((chunkX%WORLD_STREAM_SIDE) + WORLD_STREAM_SIDE)%WORLD_STREAM_SIDE;
+
+                    WorldChunk *chunk = &stream->slots[slot];
+                    if (!stream->centered || (chunk->chunkX != chunkX) || (chunk->chunkZ != chunkZ)) AssignWorldChunk(stream, slot, chunkX, chunkZ);
+                }
+            }
+        }
+
+        stream->centerX = centerX;
+        stream->centerZ = centerZ;
+        stream->centered = true;
+
+#if defined(WORLD_STREAM_THREADED)
+        if (stream->jobCount > 0) pthread_cond_signal(&stream->wake);
+#endif
+    }
+
+#if !defined(WORLD_STREAM_THREADED)
+    // No worker available: build a few chunks per frame on the main thread
+    for (int built = 0; (built < WORLD_STREAM_UPLOADS) && (stream->jobCount > 0); built++)
+    {
+        int slot = stream->jobs[stream->jobHead];
+        stream->jobHead = (stream->jobHead + 1)%WORLD_STREAM_SLOTS;
+        stream->jobCount--;
+
+        WorldChunk *chunk = &stream->slots[slot];
+        chunk->inQueue = false;
+        if (chunk->state != CHUNK_QUEUED) continue;
+
+        BuildWorldChunk(map, stream->bundle, chunk->chunkX, chunk->chunkZ, &chunk->mesh, &chunk->wireframe);
+        chunk->state = CHUNK_BUILT;
+    }
+#endif
+
+    // Hand finished chunks to the GPU, capped so a burst of chunks doesn't stall one frame
+    int uploads = 0;
+    for (int i = 0; (i < WORLD_STREAM_SLOTS) && (uploads < WORLD_STREAM_UPLOADS); i++)
+    {
+        WorldChunk *chunk = &stream->slots[i];
+        if (chunk->state != CHUNK_BUILT) continue;
+
+        UploadMesh(&chunk->mesh, false);
+        chunk->state = CHUNK_READY;
+        chunk->drawable = true;
+        uploads++;
+    }
+
+#if defined(WORLD_STREAM_THREADED)
+    pthread_mutex_unlock(&stream->mutex);
+#endif
+}
+
+// Draw the uploaded chunks touching the frustum, returns how many were drawn
+// NOTE: Only drawable slots are read, the worker never touches those
+int DrawWorldStream(const WorldStream *stream, const Frustum *frustum)
+{
+    int drawn = 0;
+
+    for (int i = 0; i < WORLD_STREAM_SLOTS; i++)
+    {
+        const WorldChunk *chunk = &stream->slots[i];
+        if (!chunk->drawable) continue;
+        if ((frustum != NULL) && !IsBoxInFrustum(frustum, chunk->bounds)) continue;
+
+        DrawMesh(chunk->mesh, stream->material, chunk->transform);
+        drawn++;
+    }
+
+    return drawn;
+}
+
+// Worker thread: build queued chunks until the stream closes
+void *WorldStreamWorker(void *data)
+{
+#if defined(WORLD_STREAM_THREADED)
+    WorldStream *stream = (WorldStream *)data;
+
+    pthread_mutex_lock(&stream->mutex);
+
+    while (!stream->quit)
+    {
+        if (stream->jobCount == 0)
+        {
+            pthread_cond_wait(&stream->wake, &stream->mutex);
+            continue;
+        }
+
+        int slot = stream->jobs[stream->jobHead];
+        stream->jobHead = (stream->jobHead + 1)%WORLD_STREAM_SLOTS;
+        stream->jobCount--;
+
+        WorldChunk *chunk = &stream->slots[slot];
+        chunk->inQueue = false;
+        if (chunk->state != CHUNK_QUEUED) continue;
+
+        int chunkX = chunk->chunkX;
+        int chunkZ = chunk->chunkZ;
+        int generation = chunk->generation;
+
+        // Build without the lock, the collision grid is never written while streaming
+        pthread_mutex_unlock(&stream->mutex);
+
+        Mesh mesh = { 0 };
+        MapWireframe wireframe = { 0 };
+        BuildWorldChunk(stream->map, stream->bundle, chunkX, chunkZ, &mesh, &wireframe);
+
+        pthread_mutex_lock(&stream->mutex);
+
+        if ((chunk->generation == generation) && (chunk->state == CHUNK_QUEUED))
+        {
+            chunk->mesh = mesh;
+            chunk->wireframe = wireframe;
+            chunk->state = CHUNK_BUILT;
+        }
+        else
+        {
+            // Slot moved on while building, nothing was uploaded so just free the arrays
+            MemFree(mesh.vertices);
+            MemFree(mesh.texcoords);
+            MemFree(mesh.normals);
+            UnloadMapWireframe(wireframe);
+        }
+    }
+
+    pthread_mutex_unlock(&stream->mutex);
+#endif
+
+    return NULL;
+}
+
+// Start the worker threads, with zero threads (or no thread support) every batch runs on the caller
+void InitJobSystem(JobSystem *system, int threadCount)
+{
+    memset(system, 0, sizeof(JobSystem));
+
+#if defined(JOB_SYSTEM_THREADED)
+    if (threadCount > MAX_JOB_THREADS) threadCount = MAX_JOB_THREADS;
+    if (threadCount < 0) threadCount = 0;
+
+    pthread_mutex_init(&system->mutex, NULL);
+    pthread_cond_init(&system->wake, NULL);
+    pthread_cond_init(&system->done, NULL);
+
+    for (int i = 0; i < threadCount; i++)
+    {
+        if (pthread_create(&system->threads[i], NULL, JobSystemWorker, system) != 0) break;
+        system->threadCount++;
+    }
+#endif
+}
+
+void CloseJobSystem(JobSystem *system)
+{
+#if defined(JOB_SYSTEM_THREADED)
+    pthread_mutex_lock(&system->mutex);
+    system->quit = true;
+    pthread_cond_broadcast(&system->wake);
+    pthread_mutex_unlock(&system->mutex);
+
+    for (int i = 0; i < system->threadCount; i++) pthread_join(system->threads[i], NULL);
+
+    pthread_cond_destroy(&system->done);
+    pthread_cond_destroy(&system->wake);
+    pthread_mutex_destroy(&system->mutex);
+#endif
+
+    system->threadCount = 0;
+}
+
+// One worker per spare core, the calling thread takes the last one
+int GetJobThreadCount(void)
+{
+#if defined(JOB_SYSTEM_THREADED) && defined(_WIN32)
+    int cores = (int)GetActiveProcessorCount(0xffff);     // ALL_PROCESSOR_GROUPS
+#elif defined(JOB_SYSTEM_THREADED)
+    int cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    int cores = 1;
+#endif
+
+    return (cores > 1)? cores - 1 : 0;
+}
+
+// Run function(data, job) for every job in [0..jobCount-1] and wait for all of them
+// Jobs are claimed one at a time, so uneven jobs still spread over the threads
+void RunJobs(JobSystem *system, JobFunction function, void *data, int jobCount)
+{
+#if defined(JOB_SYSTEM_THREADED)
+    if ((system->threadCount > 0) && (jobCount > 1))
+    {
+        pthread_mutex_lock(&system->mutex);
+        system->function = function;
+        system->data = data;
+        system->jobCount = jobCount;
+        system->nextJob = 0;
+        system->finishedJobs = 0;
+        pthread_cond_broadcast(&system->wake);
+
+        // Help out instead of idling
+        while (system->nextJob < system->jobCount)
+        {
+            int job = system->nextJob++;
+            pthread_mutex_unlock(&system->mutex);
+
+            function(data, job);
+
+            pthread_mutex_lock(&system->mutex);
+            system->finishedJobs++;
+        }
+
+        while (system->finishedJobs < system->jobCount) pthread_cond_wait(&system->done, &system->mutex);
+        pthread_mutex_unlock(&system->mutex);
+
+        return;
+    }
+#endif
+
+    // Single job or no workers: not worth a wake-up
+    for (int job = 0; job < jobCount; job++) function(data, job);
+}
+
+void *JobSystemWorker(void *data)
+{
+#if defined(JOB_SYSTEM_THREADED)
+    JobSystem *system = (JobSystem *)data;
+
+    pthread_mutex_lock(&system->mutex);
+
+    while (!system->quit)
+    {
+        if (system->nextJob >= system->jobCount)
+        {
+            pthread_cond_wait(&system->wake, &system->mutex);
+            continue;
+        }
+
+        int job = system->nextJob++;
+        JobFunction function = system->function;
+        void *jobData = system->data;
+        pthread_mutex_unlock(&system->mutex);
+
+        function(jobData, job);
+
+        pthread_mutex_lock(&system->mutex);
+        system->finishedJobs++;
+        if (system->finishedJobs == system->jobCount) pthread_cond_signal(&system->done);
+    }
+
+    pthread_mutex_unlock(&system->mutex);
+#endif
+
+    return NULL;
+}
+
+// Frustum matching the projection BeginMode3D() sets up, with the far plane pulled in to drawDistance
+Frustum GetCameraFrustum(Camera camera, float aspect, float drawDistance)
+{
+    Frustum frustum = { 0 };
+
+    Matrix view = MatrixLookAt(camera.position, camera.target, camera.up);
+    Matrix projection = MatrixPerspective(camera.fovy*DEG2RAD, aspect, RL_CULL_DISTANCE_NEAR, drawDistance);
+    Matrix m = MatrixMultiply(view, projection);
+
+    // Gribb-Hartmann: planes are sums and differences of the clip matrix rows
+    frustum.planes[0] = (Vector4){ m.m3 + m.m0, m.m7 + m.m4, m.m11 + m.m8, m.m15 + m.m12 };    // Left
+    frustum.planes[1] = (Vector4){ m.m3 - m.m0, m.m7 - m.m4, m.m11 - m.m8, m.m15 - m.m12 };    // Right
+    frustum.planes[2] = (Vector4){ m.m3 + m.m1, m.m7 + m.m5, m.m11 + m.m9, m.m15 + m.m13 };    // Bottom
+    frustum.planes[3] = (Vector4){ m.m3 - m.m1, m.m7 - m.m5, m.m11 - m.m9, m.m15 - m.m13 };    // Top
+    frustum.planes[4] = (Vector4){ m.m3 + m.m2, m.m7 + m.m6, m.m11 + m.m10, m.m15 + m.m14 };   // Near
+    frustum.planes[5] = (Vector4){ m.m3 - m.m2, m.m7 - m.m6, m.m11 - m.m10, m.m15 - m.m14 };   // Far
+
+    for (int i = 0; i < 6; i++)
+    {
+        Vector4 *plane = &frustum.planes[i];
+        float length = sqrtf(plane->x*plane->x + plane->y*plane->y + plane->z*plane->z);
+        if (length > 0.0f)
+        {
+            plane->x /= length;
+            plane->y /= length;
+            plane->z /= length;
+            plane->w /= length;
+        }
+    }
+
+    return frustum;
+}
+
+bool IsSphereInFrustum(const Frustum *frustum, Vector3 center, float radius)
+{
+    for (int i = 0; i < 6; i++)
+    {
+        const Vector4 *plane = &frustum->planes[i];
+        if (plane->x*center.x + plane->y*center.y + plane->z*center.z + plane->w < -radius) return false;
+    }
+
+    return true;
+}
+
+// Conservative: a box can pass while sitting just outside a frustum corner
+bool IsBoxInFrustum(const Frustum *frustum, BoundingBox box)
+{
+    for (int i = 0; i < 6; i++)
+    {
+        const Vector4 *plane = &frustum->planes[i];
+
+        // Corner furthest along the plane normal
+        Vector3 corner = {
+            (plane->x >= 0.0f)? box.max.x : box.min.x,
+            (plane->y >= 0.0f)? box.max.y : box.min.y,
+            (plane->z >= 0.0f)? box.max.z : box.min.z
+        };
+
+        if (plane->x*corner.x + plane->y*corner.y + plane->z*corner.z + plane->w < 0.0f) return false;
+    }
+
+    return true;
+}
+
+// Monotonic time in seconds
+double GetProfilerTime(void)
+{
+#if defined(_WIN32)
+    static long long frequency = 0;
+    long long counter = 0;
+    if (frequency == 0) QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter/frequency;
+#else
+    struct timespec now = { 0 };
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + now.tv_nsec*1e-9;
+#endif
+}
+
+void BeginProfileZone(ProfileZone zone)
+{
+    profiler.zoneStart[zone] = GetProfilerTime();
+}
+
+void EndProfileZone(ProfileZone zone)
+{
+    profiler.zoneTime[zone] += GetProfilerTime() - profiler.zoneStart[zone];
+}
+
+// Push this frame's zone times into the rolling window and the CSV, then start a new frame
+void EndProfilerFrame(void)
+{
+    for (int zone = 0; zone < PROFILE_ZONE_COUNT; zone++)
+    {
+        profiler.history[zone][profiler.historyHead] = (float)(profiler.zoneTime[zone]*1000.0);
+    }
+
+    if (profiler.csvFile != NULL)
+    {
+        fprintf(profiler.csvFile, "%ld", profiler.frameIndex);
+        for (int zone = 0; zone < PROFILE_ZONE_COUNT; zone++) fprintf(profiler.csvFile, ",%.4f", profiler.history[zone][profiler.historyHead]);
+        fprintf(profiler.csvFile, "\n");
+    }
+
+    profiler.historyHead = (profiler.historyHead + 1)%PROFILER_WINDOW;
+    if (profiler.historyCount < PROFILER_WINDOW) profiler.historyCount++;
+    profiler.frameIndex++;
+
+    memset(profiler.zoneTime, 0, sizeof(profiler.zoneTime));
+}
+
+// qsort() comparator for timing samples
+int CompareProfileSamples(const void *a, const void *b)
+{
+    float fa = *(const float *)a;
+    float fb = *(const float *)b;
+    return (fa > fb) - (fa < fb);
+}
+
+// Min, average and 99th percentile in milliseconds over the rolling window
+void GetProfileZoneStats(ProfileZone zone, float *min, float *avg, float *p99)
+{
+    *min = 0.0f;
+    *avg = 0.0f;
+    *p99 = 0.0f;
+
+    int count = profiler.historyCount;
+    if (count == 0) return;
+
+    float sorted[PROFILER_WINDOW] = { 0 };
+    memcpy(sorted, profiler.history[zone], count*sizeof(float));
+    qsort(sorted, count, sizeof(float), CompareProfileSamples);
+
+    float sum = 0.0f;
+    for (int i = 0; i < count; i++) sum += sorted[i];
+
+    *min = sorted[0];
+    *avg = sum/count;
+    *p99 = sorted[(count*99)/100];
+}
+
+void DrawProfilerOverlay(int posX, int posY)
+{
+    // Default font is proportional, keep the columns at fixed offsets
+    DrawRectangle(posX, posY, 290, 14*(PROFILE_ZONE_COUNT + 1) + 8, Fade(BLACK, 0.7f));
+    DrawText("ms", posX + 4, posY + 4, 10, LIGHTGRAY);
+    DrawText("min", posX + 130, posY + 4, 10, LIGHTGRAY);
+    DrawText("avg", posX + 180, posY + 4, 10, LIGHTGRAY);
+    DrawText("p99", posX + 230, posY + 4, 10, LIGHTGRAY);
+
+    for (int zone = 0; zone < PROFILE_ZONE_COUNT; zone++)
+    {
+        float min, avg, p99;
+        GetProfileZoneStats(zone, &min, &avg, &p99);
+
+        int lineY = posY + 4 + 14*(zone + 1);
+        Color color = (zone == PROFILE_FRAME)? YELLOW : WHITE;
+        DrawText(profileZoneNames[zone], posX + ((zone == PROFILE_WIREFRAME)? 14 : 4), lineY, 10, color);     // Nested in the 3D pass
+        DrawText(TextFormat("%.3f", min), posX + 130, lineY, 10, color);
+        DrawText(TextFormat("%.3f", avg), posX + 180, lineY, 10, color);
+        DrawText(TextFormat("%.3f", p99), posX + 230, lineY, 10, color);
+    }
+}
+
+bool StartProfilerCsv(const char *fileName)
+{
+    StopProfilerCsv();
+
+    profiler.csvFile = fopen(fileName, "w");
+    if (profiler.csvFile == NULL)
+    {
+        TraceLog(LOG_WARNING, "PROFILER: Failed to open %s", fileName);
+        return false;
+    }
+
+    // Overlay label with every space or slash as an underscore, "bullet collisions" becomes bullet_collisions_ms
+    fprintf(profiler.csvFile, "frame");
+    for (int zone = 0; zone < PROFILE_ZONE_COUNT; zone++)
+    {
+        fputc(',', profiler.csvFile);
+        for (const char *c = profileZoneNames[zone]; *c != '\0'; c++) fputc(((*c == ' ') || (*c == '/'))? '_' : *c, profiler.csvFile);
+        fprintf(profiler.csvFile, "_ms");
+    }
+    fprintf(profiler.csvFile, "\n");
+    TraceLog(LOG_INFO, "PROFILER: Recording frame timings to %s", fileName);
+
+    return true;
+}
+
+void StopProfilerCsv(void)
+{
+    if (profiler.csvFile == NULL) return;
+
+    fclose(profiler.csvFile);
+    profiler.csvFile = NULL;
+    TraceLog(LOG_INFO, "PROFILER: Stopped recording frame timings");
+}
+
+const BenchScenario *FindBenchScenario(const char *name)
+{
+    for (int i = 0; i < BENCH_SCENARIO_COUNT; i++)
+    {
+        if (strcmp(benchScenarios[i].name, name) == 0) return &benchScenarios[i];
+    }
+
+    return NULL;
+}
+
+// Scenario extras applied before every tick
+void ApplyBenchScenario(const BenchScenario *scenario, GameWorld *world, int tick)
+{
+    // Bullet storm: a rotating fan of player bullets, keeps well over a thousand alive
+    for (int i = 0; i < scenario->stormBullets; i++)
+    {
+        float angle = (float)(tick*scenario->stormBullets + i)*2.39996f;    // Golden angle spreads consecutive shots
+        Vector3 player = world->archetypes[ARCHETYPE_PLAYER].transforms[0].position;
+        Vector3 position = { player.x, player.y + 0.5f, player.z };
+        ShootBullet(&world->bullets, position, (Vector3){ cosf(angle), 0.0f, sinf(angle) }, true);
+    }
+}
+
+// Simulation-only benchmark, every tick counts as a frame
+int RunBenchmarkHeadless(const BenchScenario *scenario, int ticks)
+{
+    GameWorld *world = (GameWorld *)MemAlloc(sizeof(GameWorld));
+
+    // Same setup order as main(), so a scenario simulates the same thing windowed and headless
+    SetRandomSeed(scenario->seed);
+    InitGameWorld(world, scenario->enemyCount);
+
+    MapCollision mapCollision = { 0 };
+    int floor = 1;
+    if (scenario->dungeonSize > 0)
+    {
+        int spawnX = 0;
+        int spawnZ = 0;
+        mapCollision = LoadDungeonFloor(scenario->seed, scenario->dungeonSize, (Vector3){ -scenario->dungeonSize/2.0f, 0.0f, -scenario->dungeonSize/2.0f }, &spawnX, &spawnZ);
+        PlaceGameWorld(world, &mapCollision, spawnX, spawnZ);
+    }
+    else
+    {
+        // Same grid source as the windowed game, only the cells are kept from the bundle
+        AssetBundle bundle = LoadAssetBundle(ASSET_BUNDLE_FILE);
+        mapCollision = LoadLevelMapCollision(&bundle, (Vector3){ -16.0f, 0.0f, -8.0f });
+        UnloadAssetBundle(bundle);
+    }
+
+    if (mapCollision.grid.cells == NULL)
+    {
+        UnloadGameWorld(world);
+        MemFree(world);
+        return 1;
+    }
+
+    SpatialGrid enemyGrid = LoadSpatialGrid(&mapCollision, ENEMY_POOL_CAPACITY);
+    FlowField flowField = LoadFlowField(&mapCollision);
+    VisibilityGrid visibility = LoadVisibilityGrid(&mapCollision);
+    float *frameTimes = (float *)MemAlloc(ticks*sizeof(float));
+
+    InputBot bot = { 0 };
+    InitInputBot(&bot, scenario->seed);
+
+    double start = GetProfilerTime();
+
+    // Keep ticking after a game over so every run covers the same number of ticks
+    for (int tick = 0; tick < ticks; tick++)
+    {
+        double tickStart = GetProfilerTime();
+        ResetMemoryArena(&frameArena);
+
+        // Floor swaps count as part of the tick, like the frame that loads the next floor in a windowed run
+        if ((scenario->dungeonSize > 0) && (world->archetypes[ARCHETYPE_ENEMY].count == 0))
+        {
+            floor++;
+            AdvanceDungeonFloor(world, &mapCollision, scenario->seed, floor);
+            enemyGrid = LoadSpatialGrid(&mapCollision, ENEMY_POOL_CAPACITY);
+            flowField = LoadFlowField(&mapCollision);
+            visibility = LoadVisibilityGrid(&mapCollision);
+        }
+
+        GameInput input = UpdateInputBot(&bot, world);
+        ApplyBenchScenario(scenario, world, tick);
+        UpdateGameWorld(world, &input, &mapCollision, &enemyGrid, &flowField, &visibility);
+
+        frameTimes[tick] = (float)((GetProfilerTime() - tickStart)*1000.0);
+    }
+
+    PrintBenchmarkReport(scenario->name, "headless", ticks, GetProfilerTime() - start, frameTimes);
+
+    UnloadGameWorld(world);
+    MemFree(frameTimes);
+    MemFree(world);
+    UnloadMemoryArena(&levelArena);     // Map, grids and fields all go at once
+    UnloadMemoryArena(&frameArena);
+
+    return 0;
+}
+
+// One line per run so results are easy to diff between builds
+// NOTE: Sorts frameTimes in place
+void PrintBenchmarkReport(const char *name, const char *mode, int ticks, double seconds, float *frameTimes)
+{
+    if (ticks <= 0) return;
+
+    qsort(frameTimes, ticks, sizeof(float), CompareProfileSamples);
+
+    long peakMemory = GetPeakMemoryKB();
+
+    printf("bench %s (%s): %d ticks in %.3f s, %.0f ticks/s, frame ms p50 %.3f p90 %.3f p99 %.3f max %.3f, ",
+        name, mode, ticks, seconds, (seconds > 0.0)? ticks/seconds : 0.0,
+        frameTimes[ticks*50/100], frameTimes[ticks*90/100], frameTimes[ticks*99/100], frameTimes[ticks - 1]);
+
+    if (peakMemory >= 0) printf("peak memory %.1f MB\n", peakMemory/1024.0);
+    else printf("peak memory n/a\n");
+}
+
+// Peak resident set size of the whole process, -1 where unsupported
+long GetPeakMemoryKB(void)
+{
+#if defined(_WIN32)
+    return -1;
+#else
+    struct rusage usage = { 0 };
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+    #if defined(__APPLE__)
+        return usage.ru_maxrss/1024;    // Bytes on macOS
+    #else
+        return usage.ru_maxrss;         // Kilobytes on Linux and BSD
+    #endif
+#endif
+}
+
+// Decode the source images and build every chunk mesh into one bundle, needs no window
+// The map image is required, any other missing image stays on its source file at runtime
+int BakeAssetBundle(const char *fileName)
+{
+    Image images[BUNDLE_IMAGE_COUNT] = { 0 };
+    int sourceSizes[BUNDLE_IMAGE_COUNT] = { 0 };
+    long long sourceTimes[BUNDLE_IMAGE_COUNT] = { 0 };
+    for (int i = 0; i < BUNDLE_IMAGE_COUNT; i++)
+    {
+        bool exists = FileExists(bundleSourceFiles[i]);
+        images[i] = LoadImage(bundleSourceFiles[i]);
+        sourceSizes[i] = exists? GetFileLength(bundleSourceFiles[i]) : -1;
+        sourceTimes[i] = exists? GetFileModTime(bundleSourceFiles[i]) : 0;
+    }
+
+    if (images[BUNDLE_IMAGE_MAP].data == NULL)
+    {
+        for (int i = 0; i < BUNDLE_IMAGE_COUNT; i++) UnloadImage(images[i]);
+        return 1;
+    }
+
+    // Cut exactly like the world stream does, the position doesn't change the geometry
+    MapCollision map = LoadMapCollision(images[BUNDLE_IMAGE_MAP], (Vector3){ 0.0f, 0.0f, 0.0f });
+    int chunksX = (map.grid.width + MAP_CHUNK_SIZE - 1)/MAP_CHUNK_SIZE;
+    int chunksZ = (map.grid.height + MAP_CHUNK_SIZE - 1)/MAP_CHUNK_SIZE;
+    Mesh *chunks = (Mesh *)MemAlloc(chunksX*chunksZ*sizeof(Mesh));
+
+    for (int z = 0; z < chunksZ; z++)
+    {
+        for (int x = 0; x < chunksX; x++)
+        {
+            MapWireframe wireframe = { 0 };
+            BuildWorldChunk(&map, NULL, x, z, &chunks[z*chunksX + x], &wireframe);
+            UnloadMapWireframe(wireframe);
+        }
+    }
+
+    // Count the bytes first, then fill a buffer of exactly that size
+    BundleCursor cursor = { 0 };
+    WriteAssetBundle(&cursor, images, &map.grid, chunks, chunksX, chunksZ, sourceSizes, sourceTimes);
+    cursor.size = cursor.offset;
+    cursor.offset = 0;
+    cursor.data = (unsigned char *)MemAlloc(cursor.size);
+    WriteAssetBundle(&cursor, images, &map.grid, chunks, chunksX, chunksZ, sourceSizes, sourceTimes);
+
+    bool saved = SaveFileData(fileName, cursor.data, cursor.size);
+    if (saved) TraceLog(LOG_INFO, "BUNDLE: Baked %s (%ix%i cells, %i chunk meshes, %i bytes)", fileName, map.grid.width, map.grid.height, chunksX*chunksZ, cursor.size);
+
+    // Never uploaded, so only the CPU arrays need freeing
+    for (int i = 0; i < chunksX*chunksZ; i++)
     {
-        player->isGrounded = true;
+        MemFree(chunks[i].vertices);
+        MemFree(chunks[i].texcoords);
+        MemFree(chunks[i].normals);
     }
-    
-    UnloadImage(cubicmapImage);
-    
-    return collision;
+    MemFree(chunks);
+    MemFree(cursor.data);
+    UnloadMemoryArena(&levelArena);
+    UnloadMemoryArena(&frameArena);
+    for (int i = 0; i < BUNDLE_IMAGE_COUNT; i++) UnloadImage(images[i]);
+
+    return saved? 0 : 1;
 }
 
-// Similar function for enemies
-bool CheckCollisionEnemyWithMap(Enemy *enemy, Model model, Vector3 mapPosition, Texture2D cubicmap)
+// Serialize the bundle, a cursor without a buffer only measures it
+void WriteAssetBundle(BundleCursor *cursor, const Image *images, const CollisionGrid *grid, const Mesh *chunks, int chunksX, int chunksZ, const int *sourceSizes, const long long *sourceTimes)
 {
-    // Get enemy bounding box
-    BoundingBox enemyBounds = GetEnemyBoundingBox(*enemy);
-    
-    // Get map bounds
-    BoundingBox mapBounds = GetModelBoundingBox(model);
-    mapBounds.min = Vector3Add(mapBounds.min, mapPosition);
-    mapBounds.max = Vector3Add(mapBounds.max, mapPosition);
-    
-    // Check if enemy is outside the map bounds
-    if (!CheckCollisionBoxes(enemyBounds, mapBounds))
-        return true;
-        
-    // More precise collision detection with individual cubes
-    int cellX = (int)(enemy->position.x - mapPosition.x);
-    int cellZ = (int)(enemy->position.z - mapPosition.z);
-    
-    // We need the image data to check pixel colors
-    Image cubicmapImage = LoadImageFromTexture(cubicmap);
-    
-    bool collision = false;
-    
-    // Check the surrounding cells for collisions (3x3 grid around enemy)
-    for (int z = -1; z <= 1; z++)
+    AssetBundleHeader header = { 0 };
+    header.magic = ASSET_BUNDLE_MAGIC;
+    header.version = ASSET_BUNDLE_VERSION;
+    header.chunkSize = MAP_CHUNK_SIZE;
+    header.imageCount = BUNDLE_IMAGE_COUNT;
+    header.gridWidth = grid->width;
+    header.gridHeight = grid->height;
+    header.chunksX = chunksX;
+    header.chunksZ = chunksZ;
+    memcpy(header.sourceTimes, sourceTimes, sizeof(header.sourceTimes));
+    memcpy(header.sourceSizes, sourceSizes, sizeof(header.sourceSizes));
+    WriteBundleBytes(cursor, &header, sizeof(AssetBundleHeader));
+
+    for (int i = 0; i < BUNDLE_IMAGE_COUNT; i++)
     {
-        for (int x = -1; x <= 1; x++)
+        AssetBundleImage info = { 0 };
+        if (images[i].data != NULL)
         {
-            int currentCellX = cellX + x;
-            int currentCellZ = cellZ + z;
-            
-            // Skip cells outside the map bounds
-            if (currentCellX < 0 || currentCellZ < 0 || 
-                currentCellX >= cubicmap.width || currentCellZ >= cubicmap.height)
-                continue;
-            
-            // Check if the current cell is a wall (white pixel in the cubicmap)
-            Color cellColor = GetImageColor(cubicmapImage, currentCellX, currentCellZ);
-            
-            // If the cell is a wall (white or very light color)
-            if ((cellColor.r > 50) && (cellColor.g > 50) && (cellColor.b > 50))
-            {
-                // Create a box for the current wall cell
-                float cellXOffset = currentCellX - 0.5f;
-                float cellZOffset = currentCellZ - 0.5f;
-                BoundingBox cellBounds = {
-                    (Vector3){ mapPosition.x + cellXOffset, mapPosition.y, mapPosition.z + cellZOffset },
-                    (Vector3){ mapPosition.x + cellXOffset + 1.0f, mapPosition.y + 1.0f, mapPosition.z + cellZOffset + 1.0f }
-                };
-                
-                // Check collision between enemy and the current wall cell
-                if (CheckCollisionBoxes(enemyBounds, cellBounds))
-                {
-                    collision = true;
-                    break;
-                }
-            }
+            info.width = images[i].width;
+            info.height = images[i].height;
+            info.mipmaps = images[i].mipmaps;
+            info.format = images[i].format;
+            info.dataSize = GetImageDataSize(images[i]);
         }
-        if (collision) break;
+        WriteBundleBytes(cursor, &info, sizeof(AssetBundleImage));
+        WriteBundleBytes(cursor, images[i].data, info.dataSize);
+    }
+
+    WriteBundleBytes(cursor, grid->cells, grid->width*grid->height);
+
+    for (int i = 0; i < chunksX*chunksZ; i++)
+    {
+        WriteBundleBytes(cursor, &chunks[i].vertexCount, sizeof(int));
+        WriteBundleBytes(cursor, chunks[i].vertices, chunks[i].vertexCount*3*sizeof(float));
+        WriteBundleBytes(cursor, chunks[i].texcoords, chunks[i].vertexCount*2*sizeof(float));
+        WriteBundleBytes(cursor, chunks[i].normals, chunks[i].vertexCount*3*sizeof(float));
     }
-    
-    UnloadImage(cubicmapImage);
-    
-    return collision;
 }
 
-// Check if bullet collides with map
-bool CheckCollisionBulletWithMap(Bullet bullet, Model model, Vector3 mapPosition, Texture2D cubicmap)
+// Read the whole bundle in one call and point the tables into that buffer
+// Returns an empty bundle if the file is missing, truncated, baked by a different build or from sources changed since
+AssetBundle LoadAssetBundle(const char *fileName)
 {
-    // Get map bounds
-    BoundingBox mapBounds = GetModelBoundingBox(model);
-    mapBounds.min = Vector3Add(mapBounds.min, mapPosition);
-    mapBounds.max = Vector3Add(mapBounds.max, mapPosition);
-    
-    // Check if bullet is outside the map bounds
-    if (!CheckCollisionSphereBox(
-            bullet.position, 
-            bullet.radius, 
-            mapBounds))
-        return true;
-        
-    // More precise collision detection with individual cubes
-    int cellX = (int)(bullet.position.x - mapPosition.x);
-    int cellZ = (int)(bullet.position.z - mapPosition.z);
-    
-    // We need the image data to check pixel colors
-    Image cubicmapImage = LoadImageFromTexture(cubicmap);
-    
-    bool collision = false;
-    
-    // Check the surrounding cells for collisions (3x3 grid around bullet)
-    for (int z = -1; z <= 1; z++)
+    AssetBundle bundle = { 0 };
+    if (!FileExists(fileName)) return bundle;
+
+    BundleCursor cursor = { 0 };
+    cursor.data = LoadFileData(fileName, &cursor.size);
+    if (cursor.data == NULL) return bundle;
+
+    const AssetBundleHeader *header = (const AssetBundleHeader *)ReadBundleBytes(&cursor, sizeof(AssetBundleHeader));
+    bool valid = (header != NULL) && (header->magic == ASSET_BUNDLE_MAGIC) && (header->version == ASSET_BUNDLE_VERSION) &&
+        (header->chunkSize == MAP_CHUNK_SIZE) && (header->imageCount == BUNDLE_IMAGE_COUNT) &&
+        (header->gridWidth > 0) && (header->gridHeight > 0) && (header->gridWidth <= cursor.size/header->gridHeight) &&
+        (header->chunksX == (header->gridWidth + MAP_CHUNK_SIZE - 1)/MAP_CHUNK_SIZE) &&
+        (header->chunksZ == (header->gridHeight + MAP_CHUNK_SIZE - 1)/MAP_CHUNK_SIZE);
+
+    // Editing a source file without re-baking must not keep the old pixels, grid and meshes
+    // Only the directory entry is read, and a shipped build without the source files trusts the bundle
+    for (int i = 0; valid && (i < BUNDLE_IMAGE_COUNT); i++)
     {
-        for (int x = -1; x <= 1; x++)
+        if (!FileExists(bundleSourceFiles[i])) continue;
+
+        if ((GetFileLength(bundleSourceFiles[i]) != header->sourceSizes[i]) || (GetFileModTime(bundleSourceFiles[i]) != header->sourceTimes[i]))
         {
-            int currentCellX = cellX + x;
-            int currentCellZ = cellZ + z;
-            
-            // Skip cells outside the map bounds
-            if (currentCellX < 0 || currentCellZ < 0 || 
-                currentCellX >= cubicmap.width || currentCellZ >= cubicmap.height)
-                continue;
-            
-            // Check if the current cell is a wall (white pixel in the cubicmap)
-            Color cellColor = GetImageColor(cubicmapImage, currentCellX, currentCellZ);
-            
-            // If the cell is a wall (white or very light color)
-            if ((cellColor.r > 50) && (cellColor.g > 50) && (cellColor.b > 50))
+            TraceLog(LOG_WARNING, "BUNDLE: %s changed since %s was baked", bundleSourceFiles[i], fileName);
+            valid = false;
+        }
+    }
+
+    for (int i = 0; valid && (i < BUNDLE_IMAGE_COUNT); i++)
+    {
+        const AssetBundleImage *info = (const AssetBundleImage *)ReadBundleBytes(&cursor, sizeof(AssetBundleImage));
+        const void *pixels = (info != NULL)? ReadBundleBytes(&cursor, info->dataSize) : NULL;
+        if (pixels == NULL) valid = false;
+        else if (info->dataSize > 0)
+        {
+            Image image = { (void *)pixels, info->width, info->height, info->mipmaps, info->format };
+            if (GetImageDataSize(image) == info->dataSize) bundle.images[i] = image;
+            else valid = false;
+        }
+    }
+
+    if (valid)
+    {
+        bundle.grid.width = header->gridWidth;
+        bundle.grid.height = header->gridHeight;
+        bundle.grid.cells = (unsigned char *)ReadBundleBytes(&cursor, header->gridWidth*header->gridHeight);
+        valid = (bundle.grid.cells != NULL) && (bundle.images[BUNDLE_IMAGE_MAP].data != NULL);
+    }
+
+    if (valid)
+    {
+        bundle.chunksX = header->chunksX;
+        bundle.chunksZ = header->chunksZ;
+        bundle.chunks = (BundleMesh *)MemAlloc(bundle.chunksX*bundle.chunksZ*sizeof(BundleMesh));
+
+        for (int i = 0; valid && (i < bundle.chunksX*bundle.chunksZ); i++)
+        {
+            const int *vertexCount = (const int *)ReadBundleBytes(&cursor, sizeof(int));
+            if ((vertexCount == NULL) || (*vertexCount < 0) || (*vertexCount > cursor.size/(int)(8*sizeof(float))))
             {
-                // Create a box for the current wall cell
-                float cellXOffset = currentCellX - 0.5f;
-                float cellZOffset = currentCellZ - 0.5f;
-                BoundingBox cellBounds = {
-                    (Vector3){ mapPosition.x + cellXOffset, mapPosition.y, mapPosition.z + cellZOffset },
-                    (Vector3){ mapPosition.x + cellXOffset + 1.0f, mapPosition.y + 1.0f, mapPosition.z + cellZOffset + 1.0f }
-                };
-                
-                // Check collision between bullet and the current wall cell
-                if (CheckCollisionSphereBox(bullet.position, bullet.radius, cellBounds))
-                {
-                    collision = true;
-                    break;
-                }
+                valid = false;
+                break;
             }
+
+            BundleMesh *mesh = &bundle.chunks[i];
+            mesh->vertexCount = *vertexCount;
+            mesh->vertices = (const float *)ReadBundleBytes(&cursor, mesh->vertexCount*3*sizeof(float));
+            mesh->texcoords = (const float *)ReadBundleBytes(&cursor, mesh->vertexCount*2*sizeof(float));
+            mesh->normals = (const float *)ReadBundleBytes(&cursor, mesh->vertexCount*3*sizeof(float));
+            valid = (mesh->vertices != NULL) && (mesh->texcoords != NULL) && (mesh->normals != NULL);
         }
-        if (collision) break;
     }
-    
-    UnloadImage(cubicmapImage);
-    
-    return collision;
+
+    if (!valid)
+    {
+        TraceLog(LOG_WARNING, "BUNDLE: %s is stale or corrupt, loading the source assets instead", fileName);
+        MemFree(bundle.chunks);
+        UnloadFileData(cursor.data);
+        return (AssetBundle){ 0 };
+    }
+
+    bundle.data = cursor.data;
+    TraceLog(LOG_INFO, "BUNDLE: Loaded %s (%i bytes)", fileName, cursor.size);
+
+    return bundle;
 }
 
-// Check collision between a sphere and a box
-// Returns true if the sphere and box collide, false otherwise
-bool CheckCollisionSphereBox(Vector3 center, float radius, BoundingBox box)
+void UnloadAssetBundle(AssetBundle bundle)
 {
-    // Find the closest point to the sphere within the box
-    Vector3 closest = {
-        fmaxf(box.min.x, fminf(center.x, box.max.x)),
-        fmaxf(box.min.y, fminf(center.y, box.max.y)),
-        fmaxf(box.min.z, fminf(center.z, box.max.z))
-    };
-    
-    // Calculate the distance between the sphere's center and the closest point
-    float distanceSquared = 
-        powf(closest.x - center.x, 2.0f) + 
-        powf(closest.y - center.y, 2.0f) + 
-        powf(closest.z - center.z, 2.0f);
-    
-    // If the distance is less than the radius squared, they collide
-    return distanceSquared < (radius * radius);
+    MemFree(bundle.chunks);
+    if (bundle.data != NULL) UnloadFileData(bundle.data);
 }
 
-// New function to handle player physics (gravity, jumping, vertical movement)
-void UpdatePlayerPhysics(Player *player, float deltaTime, Model model, Vector3 mapPosition, Texture2D cubicmap)
+// Collision for the map.png level, from the bundle when it loaded, otherwise decoded from the image
+// Every mode goes through here so a windowed session, its replay and the benchmarks share one grid
+// NOTE: Returns a map without cells if neither source is available
+MapCollision LoadLevelMapCollision(const AssetBundle *bundle, Vector3 position)
 {
-    // Apply gravity
-    if (!player->isGrounded)
-    {
-        player->velocity.y -= player->gravity;
-    }
-    else if (player->velocity.y < 0)
+    if (bundle->data != NULL) return LoadMapCollisionFromGrid(LoadCollisionGridCopy(&bundle->grid), position);
+
+    Image image = LoadImage(bundleSourceFiles[BUNDLE_IMAGE_MAP]);
+    if (image.data == NULL) return (MapCollision){ 0 };
+
+    MapCollision map = LoadMapCollision(image, position);
+    UnloadImage(image);
+
+    return map;
+}
+
+// Upload straight from the bundle when it has the image, otherwise decode the source file
+Texture2D LoadBundleTexture(const AssetBundle *bundle, BundleImageId image, const char *fileName)
+{
+    if (bundle->images[image].data != NULL) return LoadTextureFromImage(bundle->images[image]);
+
+    return LoadTexture(fileName);
+}
+
+// Pixel data size including the mipmap chain
+int GetImageDataSize(Image image)
+{
+    int size = 0;
+    int width = image.width;
+    int height = image.height;
+
+    for (int i = 0; i < image.mipmaps; i++)
     {
-        // Reset vertical velocity when grounded
-        player->velocity.y = 0;
+        size += GetPixelDataSize(width, height, image.format);
+        width = (width > 1)? width/2 : 1;
+        height = (height > 1)? height/2 : 1;
     }
-    
-    // Apply vertical velocity to position
-    player->position.y += player->velocity.y;
-    
-    // Check if player is below ground level
-    if (player->position.y < 0.5f)  // Assuming 0.5f is ground level
+
+    return size;
+}
+
+// Append a block padded to 4 bytes so the ints and floats after it stay aligned
+void WriteBundleBytes(BundleCursor *cursor, const void *data, int size)
+{
+    if ((cursor->data != NULL) && (size > 0)) memcpy(cursor->data + cursor->offset, data, size);
+    cursor->offset += (size + 3) & ~3;
+}
+
+// Next block of the bundle, NULL if the file ends before it does
+const void *ReadBundleBytes(BundleCursor *cursor, int size)
+{
+    int remaining = cursor->size - cursor->offset;
+    if ((size < 0) || (size > remaining)) return NULL;
+
+    const void *block = cursor->data + cursor->offset;
+    int padded = (size + 3) & ~3;
+    cursor->offset += (padded < remaining)? padded : remaining;
+
+    return block;
+}
+
+// Start recording a session, the caller seeds the RNG with the same seed
+void InitReplay(Replay *replay, unsigned int seed, int dungeonSize)
+{
+    memset(replay, 0, sizeof(Replay));
+    replay->header.magic = REPLAY_MAGIC;
+    replay->header.version = REPLAY_VERSION;
+    replay->header.seed = seed;
+    replay->header.dungeon = dungeonSize;
+
+    replay->capacity = 60*SIMULATION_TICK_RATE;    // About a minute of idle ticks, grows by doubling
+    replay->records = (unsigned char *)MemAlloc(replay->capacity);
+}
+
+// Read a recording in one call, false if it is missing, truncated or from another version
+bool LoadReplay(Replay *replay, const char *fileName)
+{
+    memset(replay, 0, sizeof(Replay));
+    if (!FileExists(fileName)) return false;
+
+    int size = 0;
+    unsigned char *data = LoadFileData(fileName, &size);
+    if (data == NULL) return false;
+
+    bool valid = (size >= (int)sizeof(ReplayHeader));
+    if (valid)
     {
-        player->position.y = 0.5f;
-        player->velocity.y = 0;
-        player->isGrounded = true;
+        memcpy(&replay->header, data, sizeof(ReplayHeader));
+        valid = (replay->header.magic == REPLAY_MAGIC) && (replay->header.version == REPLAY_VERSION) && (replay->header.tickCount >= 0) &&
+            ((replay->header.dungeon == 0) || ((replay->header.dungeon >= DUNGEON_ROOM_MIN + 2) && (replay->header.dungeon <= DUNGEON_SIZE_MAX)));
     }
-    else
+
+    if (valid)
     {
-        // Check for collisions with the map
-        player->isGrounded = false;  // Assume not grounded until proven otherwise
-        
-        // Only check for ground collisions, not ceiling collisions
-        if (player->velocity.y < 0)  // Only when falling
-        {
-            if (CheckCollisionPlayerWithMap(player, model, mapPosition, cubicmap))
-            {
-                // We hit something while falling, but it wasn't the ground
-                // This is for horizontal collisions during fall
-            }
-            
-            // Check if we've landed on ground
-            // Get player bounding box
-            BoundingBox playerBounds = GetPlayerBoundingBox(*player);
-            
-            // We need the image data to check pixel colors
-            Image cubicmapImage = LoadImageFromTexture(cubicmap);
-            
-            // Calculate the grid cell position where the player is currently located
-            int cellX = (int)(player->position.x - mapPosition.x);
-            int cellZ = (int)(player->position.z - mapPosition.z);
-            
-            // Check for ground beneath player
-            for (int z = -1; z <= 1; z++)
-            {
-                for (int x = -1; x <= 1; x++)
-                {
-                    int currentCellX = cellX + x;
-                    int currentCellZ = cellZ + z;
-                    
-                    // Skip cells outside the map bounds
-                    if (currentCellX < 0 || currentCellZ < 0 || 
-                        currentCellX >= cubicmap.width || currentCellZ >= cubicmap.height)
-                        continue;
-                    
-                    // Check if the current cell is a wall (white pixel in the cubicmap)
-                    Color cellColor = GetImageColor(cubicmapImage, currentCellX, currentCellZ);
-                    
-                    // If the cell is a wall (white or very light color)
-                    if ((cellColor.r > 50) && (cellColor.g > 50) && (cellColor.b > 50))
-                    {
-                        // Create a box for the current wall cell
-                        float cellXOffset = currentCellX - 0.5f;
-                        float cellZOffset = currentCellZ - 0.5f;
-                        BoundingBox cellBounds = {
-                            (Vector3){ mapPosition.x + cellXOffset, mapPosition.y, mapPosition.z + cellZOffset },
-                            (Vector3){ mapPosition.x + cellXOffset + 1.0f, mapPosition.y + 1.0f, mapPosition.z + cellZOffset + 1.0f }
-                        };
-                        
-                        // Check if player's bottom is at or slightly above the cell's top
-                        if (playerBounds.min.y <= cellBounds.max.y && 
-                            playerBounds.min.y >= cellBounds.max.y - 0.1f &&
-                            CheckCollisionBoxes(playerBounds, cellBounds))
-                        {
-                            player->isGrounded = true;
-                            player->position.y = cellBounds.max.y;
-                            player->velocity.y = 0;
-                            break;
-                        }
-                    }
-                }
-                if (player->isGrounded) break;
-            }
-            
-            UnloadImage(cubicmapImage);
-        }
+        replay->size = size - (int)sizeof(ReplayHeader);
+        replay->capacity = replay->size;
+        replay->records = (unsigned char *)MemAlloc((replay->size > 0)? replay->size : 1);
+        memcpy(replay->records, data + sizeof(ReplayHeader), replay->size);
     }
+
+    UnloadFileData(data);
+
+    return valid;
 }
 
-// Update camera to follow player
-void UpdateGameCamera(Camera *camera, Player player)
+// Header and records written in one call
+bool SaveReplay(const Replay *replay, const char *fileName)
 {
-    // Update camera position to follow player from a top-down perspective
-    camera->position.x = player.position.x;
-    camera->position.z = player.position.z + 10.0f;
-    camera->target = player.position;
+    int size = (int)sizeof(ReplayHeader) + replay->size;
+    unsigned char *data = (unsigned char *)MemAlloc(size);
+    memcpy(data, &replay->header, sizeof(ReplayHeader));
+    memcpy(data + sizeof(ReplayHeader), replay->records, replay->size);
+
+    bool saved = SaveFileData(fileName, data, size);
+    if (saved) TraceLog(LOG_INFO, "REPLAY: Saved %s (%i ticks, %i bytes)", fileName, replay->header.tickCount, size);
+
+    MemFree(data);
+
+    return saved;
 }
 
-// Shoot bullet from a position in a direction
-void ShootBullet(Bullet *bullets, int *bulletCount, Vector3 position, Vector3 direction, bool fromPlayer)
+void UnloadReplay(Replay *replay)
 {
-    // Don't shoot if bullet array is full
-    if (*bulletCount >= MAX_BULLETS) return;
-    
-    // Find an inactive bullet slot
-    int bulletIndex = -1;
-    for (int i = 0; i < MAX_BULLETS; i++)
+    MemFree(replay->records);
+    memset(replay, 0, sizeof(Replay));
+}
+
+// Append the input a tick just ran with, and the world checksum it produced
+// NOTE: Idle and movement-only ticks are one byte, values are only stored on ticks that use them
+void RecordReplayTick(Replay *replay, const GameInput *input, unsigned int checksum)
+{
+    unsigned char flags = 0;
+    if (input->moveRight) flags |= REPLAY_MOVE_RIGHT;
+    if (input->moveLeft) flags |= REPLAY_MOVE_LEFT;
+    if (input->moveDown) flags |= REPLAY_MOVE_DOWN;
+    if (input->moveUp) flags |= REPLAY_MOVE_UP;
+    if (input->jump) flags |= REPLAY_JUMP;
+    if (input->shoot) flags |= REPLAY_SHOOT;
+    if (replay->wheel != 0.0f) flags |= REPLAY_WHEEL;
+    if (replay->restart) flags |= REPLAY_RESTART;
+
+    int recordSize = 1 + ((flags & REPLAY_SHOOT)? 6*sizeof(float) : 0) + ((flags & REPLAY_WHEEL)? sizeof(float) : 0);
+    if (replay->size + recordSize > replay->capacity)
     {
-        if (!bullets[i].active)
-        {
-            bulletIndex = i;
-            break;
-        }
+        while (replay->size + recordSize > replay->capacity) replay->capacity *= 2;
+        replay->records = (unsigned char *)MemRealloc(replay->records, replay->capacity);
     }
-    
-    // If no inactive bullet found, use the oldest one
-    if (bulletIndex == -1)
+
+    unsigned char *record = replay->records + replay->size;
+    *record++ = flags;
+    if (flags & REPLAY_SHOOT)
     {
-        bulletIndex = *bulletCount % MAX_BULLETS;
+        float ray[6] = { input->shootRay.position.x, input->shootRay.position.y, input->shootRay.position.z,
+            input->shootRay.direction.x, input->shootRay.direction.y, input->shootRay.direction.z };
+        memcpy(record, ray, sizeof(ray));
+        record += sizeof(ray);
     }
-    else
+    if (flags & REPLAY_WHEEL) memcpy(record, &replay->wheel, sizeof(float));
+
+    replay->size += recordSize;
+    replay->wheel = 0.0f;
+    replay->restart = false;
+    replay->tick++;
+    replay->header.tickCount = replay->tick;
+    replay->header.checksum = checksum;
+}
+
+// Next recorded tick, false once the recording runs out or a record is cut short
+bool ReadReplayTick(Replay *replay, GameInput *input, float *wheel)
+{
+    *wheel = 0.0f;
+    if ((replay->tick >= replay->header.tickCount) || (replay->offset >= replay->size)) return false;
+
+    unsigned char flags = replay->records[replay->offset];
+    int recordSize = 1 + ((flags & REPLAY_SHOOT)? 6*sizeof(float) : 0) + ((flags & REPLAY_WHEEL)? sizeof(float) : 0);
+    if (replay->offset + recordSize > replay->size) return false;
+
+    const unsigned char *record = replay->records + replay->offset + 1;
+    memset(input, 0, sizeof(GameInput));
+    input->moveRight = (flags & REPLAY_MOVE_RIGHT) != 0;
+    input->moveLeft = (flags & REPLAY_MOVE_LEFT) != 0;
+    input->moveDown = (flags & REPLAY_MOVE_DOWN) != 0;
+    input->moveUp = (flags & REPLAY_MOVE_UP) != 0;
+    input->jump = (flags & REPLAY_JUMP) != 0;
+    input->shoot = (flags & REPLAY_SHOOT) != 0;
+    if (flags & REPLAY_SHOOT)
     {
-        (*bulletCount)++;
+        float ray[6] = { 0 };
+        memcpy(ray, record, sizeof(ray));
+        record += sizeof(ray);
+        input->shootRay = (Ray){ (Vector3){ ray[0], ray[1], ray[2] }, (Vector3){ ray[3], ray[4], ray[5] } };
     }
-    
-    // Initialize the bullet
-    bullets[bulletIndex].position = position;
-    bullets[bulletIndex].direction = direction;
-    bullets[bulletIndex].speed = BULLET_SPEED;
-    bullets[bulletIndex].radius = BULLET_RADIUS;
-    bullets[bulletIndex].active = true;
-    bullets[bulletIndex].fromPlayer = fromPlayer;
-    
-    // Set color based on who shot it
-    bullets[bulletIndex].color = fromPlayer ? YELLOW : RED;
+    if (flags & REPLAY_WHEEL) memcpy(wheel, record, sizeof(float));
+
+    replay->offset += recordSize;
+    replay->tick++;
+
+    return true;
 }
 
-// Update all active bullets
-void UpdateBullets(Bullet *bullets, int bulletCount, float deltaTime)
+// The next tick was recorded right after a restart, the caller restores its checkpoint before anything else
+bool IsReplayRestartNext(const Replay *replay)
 {
-    for (int i = 0; i < bulletCount; i++)
+    return (replay->tick < replay->header.tickCount) && (replay->offset < replay->size) && ((replay->records[replay->offset] & REPLAY_RESTART) != 0);
+}
+
+// Every recorded tick has run and the world ended up where the recording did
+bool IsReplayInSync(const Replay *replay, const GameWorld *world)
+{
+    return (replay->tick == replay->header.tickCount) && (GetWorldChecksum(world) == replay->header.checksum);
+}
+
+// Re-run a recording without a window as fast as possible, timing every tick
+// Returns non-zero if the session diverged, so a script can catch determinism regressions
+int RunReplayHeadless(Replay *replay, const char *name)
+{
+    bool dungeon = (replay->header.dungeon != 0);
+    int dungeonSize = replay->header.dungeon;
+    unsigned int seed = replay->header.seed;
+    GameWorld *world = (GameWorld *)MemAlloc(sizeof(GameWorld));
+
+    // Same setup order as main(), the random stream has to line up
+    SetRandomSeed(seed);
+    InitGameWorld(world, 10);
+
+    MapCollision mapCollision = { 0 };
+    if (dungeon)
     {
-        if (bullets[i].active)
+        int spawnX = 0;
+        int spawnZ = 0;
+        mapCollision = LoadDungeonFloor(seed, dungeonSize, (Vector3){ -dungeonSize/2.0f, 0.0f, -dungeonSize/2.0f }, &spawnX, &spawnZ);
+        PlaceGameWorld(world, &mapCollision, spawnX, spawnZ);
+    }
+    else
+    {
+        AssetBundle bundle = LoadAssetBundle(ASSET_BUNDLE_FILE);
+        mapCollision = LoadLevelMapCollision(&bundle, (Vector3){ -16.0f, 0.0f, -8.0f });
+        UnloadAssetBundle(bundle);
+
+        if (mapCollision.grid.cells == NULL)
         {
-            // Move bullet in its direction
-            bullets[i].position.x += bullets[i].direction.x * bullets[i].speed;
-            bullets[i].position.y += bullets[i].direction.y * bullets[i].speed;
-            bullets[i].position.z += bullets[i].direction.z * bullets[i].speed;
-            
-            // Deactivate bullets that go too far (prevent infinitely traveling bullets)
-            float distance = Vector3Length(bullets[i].position);
-            if (distance > 50.0f)
-            {
-                bullets[i].active = false;
-            }
+            UnloadGameWorld(world);
+            MemFree(world);
+            return 1;
         }
     }
-}
 
-// Update enemies behavior
-void UpdateEnemies(Enemy *enemies, int enemyCount, Player player, Bullet *bullets, int *bulletCount, float deltaTime, Model model, Vector3 mapPosition, Texture2D cubicmap)
-{
-    for (int i = 0; i < enemyCount; i++)
+    SpatialGrid enemyGrid = LoadSpatialGrid(&mapCollision, ENEMY_POOL_CAPACITY);
+    FlowField flowField = LoadFlowField(&mapCollision);
+    VisibilityGrid visibility = LoadVisibilityGrid(&mapCollision);
+    float *frameTimes = (float *)MemAlloc(((replay->header.tickCount > 0)? replay->header.tickCount : 1)*sizeof(float));
+
+    GameSnapshot checkpoint = { 0 };
+    SaveGameSnapshot(&checkpoint, world);
+
+    int floor = 1;
+    int ticks = 0;
+    GameInput input = { 0 };
+    float wheel = 0.0f;
+    double start = GetProfilerTime();
+
+    while (replay->tick < replay->header.tickCount)
     {
-        if (enemies[i].active)
+        double tickStart = GetProfilerTime();
+        ResetMemoryArena(&frameArena);
+
+        // Ticks were only recorded while playing, so a game over followed by more ticks was resumed
+        if (IsReplayRestartNext(replay)) RestoreGameSnapshot(world, &checkpoint);
+        world->state = GAME_PLAYING;
+
+        // The live game swaps floors before the next tick runs, never in between
+        if (dungeon && (world->archetypes[ARCHETYPE_ENEMY].count == 0))
         {
-            // Update hit timer for enemy
-            if (enemies[i].isHit)
-            {
-                enemies[i].hitTimer -= deltaTime;
-                if (enemies[i].hitTimer <= 0.0f)
-                {
-                    enemies[i].isHit = false;
-                }
-            }
-            
-            // Simple AI - move towards player if not too close
-            Vector3 direction = Vector3Subtract(player.position, enemies[i].position);
-            float distance = Vector3Length(direction);
-            
-            // Normalize direction
-            if (distance > 0)
-            {
-                direction = Vector3Scale(Vector3Normalize(direction), enemies[i].speed);
-            }
-            
-            // Only move if not too close to player
-            if (distance > 3.0f)
-            {
-                // Store previous position
-                Vector3 previousPosition = enemies[i].position;
-                
-                // Move towards player
-                enemies[i].position.x += direction.x;
-                
-                // Check for collision after x movement
-                if (CheckCollisionEnemyWithMap(&enemies[i], model, mapPosition, cubicmap))
-                {
-                    // Restore x position if collision detected
-                    enemies[i].position.x = previousPosition.x;
-                }
-                
-                // Move in z direction separately
-                enemies[i].position.z += direction.z;
-                
-                // Check for collision after z movement
-                if (CheckCollisionEnemyWithMap(&enemies[i], model, mapPosition, cubicmap))
-                {
-                    // Restore z position if collision detected
-                    enemies[i].position.z = previousPosition.z;
-                }
-            }
-            
-            // Shooting logic - enemies shoot at player periodically
-            enemies[i].shootTimer -= deltaTime;
-            if (enemies[i].shootTimer <= 0 && distance < 10.0f) // Only shoot if player is within range
-            {
-                // Calculate direction to player
-                Vector3 shootDirection = Vector3Normalize(Vector3Subtract(
-                    (Vector3){ player.position.x, player.position.y + 0.5f, player.position.z },
-                    (Vector3){ enemies[i].position.x, enemies[i].position.y + 0.5f, enemies[i].position.z }
-                ));
-                
-                // Shoot bullet at player
-                ShootBullet(bullets, bulletCount, 
-                    (Vector3){ enemies[i].position.x, enemies[i].position.y + 0.5f, enemies[i].position.z },
-                    shootDirection, false);
-                
-                // Reset shoot timer with random variation
-                enemies[i].shootTimer = enemies[i].shootCooldown + GetRandomValue(-50, 50) / 100.0f;
-            }
+            floor++;
+            AdvanceDungeonFloor(world, &mapCollision, seed, floor);
+            SaveGameSnapshot(&checkpoint, world);
+            enemyGrid = LoadSpatialGrid(&mapCollision, ENEMY_POOL_CAPACITY);
+            flowField = LoadFlowField(&mapCollision);
+            visibility = LoadVisibilityGrid(&mapCollision);
         }
+
+        if (!ReadReplayTick(replay, &input, &wheel)) break;
+        UpdateGameWorld(world, &input, &mapCollision, &enemyGrid, &flowField, &visibility);
+
+        frameTimes[ticks++] = (float)((GetProfilerTime() - tickStart)*1000.0);
     }
+
+    PrintBenchmarkReport(name, "replay headless", ticks, GetProfilerTime() - start, frameTimes);
+
+    bool inSync = IsReplayInSync(replay, world);
+    printf("replay %s: %s after %d of %d ticks\n", name, inSync? "in sync" : "DIVERGED", ticks, replay->header.tickCount);
+
+    MemFree(frameTimes);
+    UnloadGameSnapshot(&checkpoint);
+    UnloadGameWorld(world);
+    MemFree(world);
+    UnloadMemoryArena(&levelArena);
+    UnloadMemoryArena(&frameArena);
+
+    return inSync? 0 : 1;
 }
 
-// Check all bullet collisions with player, enemies, and map
-void CheckBulletCollisions(Bullet *bullets, int bulletCount, Player *player, Enemy *enemies, int enemyCount, Model model, Vector3 mapPosition, Texture2D cubicmap)
+// FNV-1a over the state a diverging replay would show first: the player, every enemy and the bullet count
+unsigned int GetWorldChecksum(const GameWorld *world)
 {
-    for (int i = 0; i < bulletCount; i++)
+    unsigned int hash = 2166136261u;
+
+    #define CHECKSUM_BYTES(value) { \
+        const unsigned char *bytes = (const unsigned char *)&(value); \
+        for (int b = 0; b < (int)sizeof(value); b++) hash = (hash ^ bytes[b])*16777619u; \
+    }
+
+    for (int a = 0; a < ARCHETYPE_COUNT; a++)
     {
-        if (bullets[i].active)
+        const Archetype *archetype = &world->archetypes[a];
+        CHECKSUM_BYTES(archetype->count);
+        for (int i = 0; i < archetype->count; i++)
         {
-            // Check collision with map
-            if (CheckCollisionBulletWithMap(bullets[i], model, mapPosition, cubicmap))
-            {
-                bullets[i].active = false;
-                continue;
-            }
-            
-            // Check collision with player (only enemy bullets)
-            if (!bullets[i].fromPlayer)
-            {
-                BoundingBox playerBox = GetPlayerBoundingBox(*player);
-                if (CheckCollisionSphereBox(bullets[i].position, bullets[i].radius, playerBox))
-                {
-                    // Player hit by enemy bullet
-                    if (!player->isHit) // Only take damage if not in hit state
-                    {
-                        player->health -= 10;
-                        player->isHit = true;
-                        player->hitTimer = 0.5f; // Invulnerability period
-                    }
-                    
-                    bullets[i].active = false;
-                    continue;
-                }
-            }
-            
-            // Check collision with enemies (only player bullets)
-            if (bullets[i].fromPlayer)
-            {
-                for (int j = 0; j < enemyCount; j++)
-                {
-                    if (enemies[j].active)
-                    {
-                        BoundingBox enemyBox = GetEnemyBoundingBox(enemies[j]);
-                        if (CheckCollisionSphereBox(bullets[i].position, bullets[i].radius, enemyBox))
-                        {
-                            // Enemy hit by player bullet
-                            if (!enemies[j].isHit) // Only take damage if not in hit state
-                            {
-                                enemies[j].health -= 10;
-                                enemies[j].isHit = true;
-                                enemies[j].hitTimer = 0.2f; // Shorter invulnerability than player
-                                
-                                // Check if enemy is defeated
-                                if (enemies[j].health <= 0)
-                                {
-                                    enemies[j].active = false;
-                                }
-                            }
-                            
-                            bullets[i].active = false;
-                            break;
-                        }
-                    }
-                }
-            }
+            CHECKSUM_BYTES(archetype->transforms[i].position);
+            CHECKSUM_BYTES(archetype->healths[i].health);
         }
     }
-}
\ No newline at end of file
+
+    CHECKSUM_BYTES(world->bullets.count);
+
+    #undef CHECKSUM_BYTES
+
+    return hash;
+}
+
+// Swap in the next generated floor, the player keeps their health
+// NOTE: Simulation side only, the level arena is reset so the caller reloads everything else it held
+void AdvanceDungeonFloor(GameWorld *world, MapCollision *map, unsigned int seed, int floor)
+{
+    Vector3 position = map->position;
+    ResetMemoryArena(&levelArena);
+
+    int spawnX = 0;
+    int spawnZ = 0;
+    *map = LoadDungeonFloor(seed + floor - 1, map->grid.width, position, &spawnX, &spawnZ);
+
+    int health = world->archetypes[ARCHETYPE_PLAYER].healths[0].health;
+    UnloadGameWorld(world);
+    InitGameWorld(world, 10 + 5*(floor - 1));
+    PlaceGameWorld(world, map, spawnX, spawnZ);
+    world->archetypes[ARCHETYPE_PLAYER].healths[0].health = health;
+}
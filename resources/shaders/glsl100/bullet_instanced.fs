@@ -0,0 +1,12 @@
+#version 100
+
+precision mediump float;
+
+// Input uniform values
+uniform vec4 colDiffuse;
+
+void main()
+{
+    // Flat colour, same look as DrawSphere()
+    gl_FragColor = colDiffuse;
+}
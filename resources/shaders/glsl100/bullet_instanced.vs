@@ -0,0 +1,14 @@
+#version 100
+
+// Input vertex attributes
+attribute vec3 vertexPosition;
+attribute mat4 instanceTransform;
+
+// Input uniform values
+uniform mat4 mvp;
+
+void main()
+{
+    // raylib sets mvp to view*projection for instanced draws, the model matrix comes per instance
+    gl_Position = mvp*instanceTransform*vec4(vertexPosition, 1.0);
+}
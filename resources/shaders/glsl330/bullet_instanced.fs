@@ -0,0 +1,13 @@
+#version 330
+
+// Input uniform values
+uniform vec4 colDiffuse;
+
+// Output fragment color
+out vec4 finalColor;
+
+void main()
+{
+    // Flat colour, same look as DrawSphere()
+    finalColor = colDiffuse;
+}